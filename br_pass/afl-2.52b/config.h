@@ -286,6 +286,16 @@
 
 #define MSAN_ERROR          86
 
+/* Exit status of a child that stopped right after its AFL_BR_TARGET compare
+   (br_pass runtime): */
+
+#define BR_TARGET_EXIT      92
+
+/* Calls a compare inside a loop makes to the br_pass runtime per exec, unless
+   overridden by AFL_BR_SITE_BUDGET at compile time (0 disables, max 255): */
+
+#define BR_SITE_BUDGET      64
+
 /* Designated file descriptors for forkserver commands (the application will
    use FORKSRV_FD and FORKSRV_FD + 1): */
 
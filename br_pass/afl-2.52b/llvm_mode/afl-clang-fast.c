@@ -22,6 +22,7 @@
  */
 
 #define AFL_MAIN
+#define _GNU_SOURCE
 
 #include "../config.h"
 #include "../types.h"
@@ -32,11 +33,40 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* Maximum number of instrumentation variants built by AFL_MULTI. */
+
+#define MULTI_MAX 16
 
 static u8*  obj_path;               /* Path to runtime libraries         */
 static u8** cc_params;              /* Parameters passed to the real CC  */
 static u32  cc_par_cnt = 1;         /* Param count, including argv0      */
 
+static u8   maybe_linking = 1,      /* Might this call link a binary?    */
+            c_set,                  /* -c given                          */
+            pre_set,                /* -S or -E given                    */
+            shared_set;             /* -shared given                     */
+
+static u32  src_cnt;                /* Non-assembly sources among inputs */
+static u8*  src_name;               /* ... the last of them              */
+
+static s32  out_idx = -1,           /* cc_params index of the -o value   */
+            load_idx = -1,          /* ... of the -Xclang -load plugin   */
+            rt_idx = -1;            /* ... of the runtime object         */
+
+static u8*  multi_sfx[MULTI_MAX];   /* AFL_MULTI: binary suffix          */
+static u8*  multi_dir[MULTI_MAX];   /* AFL_MULTI: dir of pass + runtime  */
+static u32  multi_cnt;              /* AFL_MULTI: number of variants     */
+static u8*  multi_cache;            /* AFL_MULTI: variant objects, state */
+
 
 /* Try to find the runtime libraries. If that fails, abort. */
 
@@ -92,11 +122,100 @@ static void find_obj(u8* argv0) {
 }
 
 
+/* Parse AFL_MULTI, a list of <suffix>=<pass dir> entries separated by
+   commas. The first variant is the one the regular -o output gets. */
+
+static void parse_multi(u8* spec) {
+
+  u8 *cur, *tok;
+
+#ifdef USE_TRACE_PC
+  FATAL("AFL_MULTI is not available with 'trace-pc'");
+#endif /* USE_TRACE_PC */
+
+  if (getenv("AFL_TAINT"))
+    FATAL("AFL_MULTI and AFL_TAINT are mutually exclusive");
+
+  multi_cache = getenv("AFL_MULTI_CACHE");
+
+  if (!multi_cache || multi_cache[0] != '/')
+    FATAL("AFL_MULTI needs an absolute AFL_MULTI_CACHE directory");
+
+  if (mkdir(multi_cache, 0700) && errno != EEXIST)
+    PFATAL("Unable to create '%s'", multi_cache);
+
+  cur = ck_strdup(spec);
+
+  for (tok = strtok(cur, ","); tok; tok = strtok(NULL, ",")) {
+
+    u8* eq = strchr(tok, '=');
+    u8* tmp;
+
+    if (!eq) FATAL("Bad AFL_MULTI entry '%s', expected <suffix>=<dir>", tok);
+
+    if (multi_cnt == MULTI_MAX)
+      FATAL("Too many AFL_MULTI variants (limit is %u)", MULTI_MAX);
+
+    *eq = 0;
+
+    if (multi_cnt && !*tok)
+      FATAL("Only the first AFL_MULTI variant may have an empty suffix");
+
+    tmp = alloc_printf("%s/afl-llvm-pass.so", eq + 1);
+
+    if (access(tmp, R_OK)) FATAL("Unable to find '%s'", tmp);
+
+    ck_free(tmp);
+
+    multi_sfx[multi_cnt] = tok;
+    multi_dir[multi_cnt] = eq + 1;
+    multi_cnt++;
+
+  }
+
+  if (!multi_cnt) FATAL("AFL_MULTI lists no variants");
+
+  obj_path = multi_dir[0];
+
+}
+
+
+/* Is cur a file clang would compile rather than hand to the linker? */
+
+static u8 is_source(u8* cur) {
+
+  static const char* ext[] = { ".c", ".cc", ".cpp", ".cxx", ".c++", ".C",
+                               ".m", ".mm", ".i", ".ii", ".s", ".S", ".ll",
+                               ".bc", NULL };
+  u8* dot = strrchr(cur, '.');
+  u32 i;
+
+  if (cur[0] == '-' || !dot) return 0;
+
+  for (i = 0; ext[i]; i++)
+    if (!strcmp(dot, ext[i])) return 1;
+
+  return 0;
+
+}
+
+
+/* Assembly gets no pass, so its objects have no variants. */
+
+static u8 is_asm(u8* cur) {
+
+  u32 len = strlen(cur);
+
+  return len > 2 && (!strcmp(cur + len - 2, ".s") || !strcmp(cur + len - 2, ".S"));
+
+}
+
+
 /* Copy argv to cc_params, making the necessary edits. */
 
 static void edit_params(u32 argc, char** argv) {
 
-  u8 fortify_set = 0, asan_set = 0, x_set = 0, maybe_linking = 1, bit_mode = 0;
+  u8 fortify_set = 0, asan_set = 0, x_set = 0, bit_mode = 0;
   u8 *name;
 
   cc_params = ck_alloc((argc + 128) * sizeof(u8*));
@@ -124,6 +243,7 @@ static void edit_params(u32 argc, char** argv) {
   cc_params[cc_par_cnt++] = "-mllvm";
   cc_params[cc_par_cnt++] = "-sanitizer-coverage-block-threshold=0";
 #else
+  load_idx = cc_par_cnt;
   cc_params[cc_par_cnt++] = "-Xclang";
   cc_params[cc_par_cnt++] = "-load";
   cc_params[cc_par_cnt++] = "-Xclang";
@@ -147,12 +267,23 @@ static void edit_params(u32 argc, char** argv) {
     if (!strcmp(cur, "-c") || !strcmp(cur, "-S") || !strcmp(cur, "-E"))
       maybe_linking = 0;
 
+    if (!strcmp(cur, "-c")) c_set = 1;
+    if (!strcmp(cur, "-S") || !strcmp(cur, "-E")) pre_set = 1;
+    if (!strcmp(cur, "-o") && argc > 1) out_idx = cc_par_cnt + 1;
+    if (is_source(cur) && !is_asm(cur)) {
+      src_cnt++;
+      src_name = cur;
+    }
+
     if (!strcmp(cur, "-fsanitize=address") ||
         !strcmp(cur, "-fsanitize=memory")) asan_set = 1;
 
     if (strstr(cur, "FORTIFY_SOURCE")) fortify_set = 1;
 
-    if (!strcmp(cur, "-shared")) maybe_linking = 0;
+    if (!strcmp(cur, "-shared")) maybe_linking = 0, shared_set = 1;
+
+    if (!strcmp(cur, "--version") || !strncmp(cur, "-print-", 7) ||
+        !strncmp(cur, "-dump", 5)) maybe_linking = 0;
 
     if (!strcmp(cur, "-Wl,-z,defs") ||
         !strcmp(cur, "-Wl,--no-undefined")) continue;
@@ -205,6 +336,21 @@ static void edit_params(u32 argc, char** argv) {
 
 #endif /* USE_TRACE_PC */
 
+  /* Taint flavour: DataFlowSanitizer with our ABI list, see
+     afl-llvm-taint-rt.o.c. */
+
+  if (getenv("AFL_TAINT")) {
+
+    if (asan_set || getenv("AFL_USE_ASAN") || getenv("AFL_USE_MSAN"))
+      FATAL("ASAN/MSAN and AFL_TAINT are mutually exclusive");
+
+    cc_params[cc_par_cnt++] = "-fsanitize=dataflow";
+    cc_params[cc_par_cnt++] = "-mllvm";
+    cc_params[cc_par_cnt++] =
+      alloc_printf("-dfsan-abilist=%s/afl-taint-abilist.txt", obj_path);
+
+  }
+
   if (!getenv("AFL_DONT_OPTIMIZE")) {
 
     cc_params[cc_par_cnt++] = "-g";
@@ -278,7 +424,14 @@ static void edit_params(u32 argc, char** argv) {
       cc_params[cc_par_cnt++] = "none";
     }
 
-    switch (bit_mode) {
+    if (getenv("AFL_TAINT")) {
+
+      cc_params[cc_par_cnt++] = alloc_printf("%s/afl-llvm-taint-rt.o", obj_path);
+
+      if (access(cc_params[cc_par_cnt - 1], R_OK))
+        FATAL("AFL_TAINT is not supported by your compiler");
+
+    } else switch (bit_mode) {
 
       case 0:
         cc_params[cc_par_cnt++] = alloc_printf("%s/afl-llvm-rt.o", obj_path);
@@ -302,8 +455,532 @@ static void edit_params(u32 argc, char** argv) {
 
     }
 
+    /* AFL_MULTI swaps the runtime for the one of each variant */
+
+    if (!getenv("AFL_TAINT")) rt_idx = cc_par_cnt - 1;
+
+  }
+
+  cc_params[cc_par_cnt] = NULL;
+
+}
+
+
+/* Start params in dir (or here), with stdout to out if given. */
+
+static pid_t spawn_params(u8** params, u8* dir, u8* out) {
+
+  pid_t pid = fork();
+
+  if (pid < 0) PFATAL("fork() failed");
+
+  if (!pid) {
+
+    if (dir && chdir(dir)) PFATAL("chdir('%s') failed", dir);
+
+    if (out) {
+
+      s32 fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+      if (fd < 0) PFATAL("Unable to create '%s'", out);
+
+      dup2(fd, 1);
+      close(fd);
+
+    }
+
+    execvp(params[0], (char**)params);
+
+    PFATAL("Oops, failed to execute '%s' - check your PATH", params[0]);
+
+  }
+
+  return pid;
+
+}
+
+
+/* Wait for a child of spawn_params() and return its exit status. */
+
+static s32 wait_params(pid_t pid) {
+
+  s32 status;
+
+  if (waitpid(pid, &status, 0) <= 0) PFATAL("waitpid() failed");
+
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+
+}
+
+
+static s32 run_params(u8** params, u8* dir, u8* out) {
+
+  return wait_params(spawn_params(params, dir, out));
+
+}
+
+
+/* FNV-1a of the contents of fn: the key of its variants in the cache. */
+
+static u64 hash_file(u8* fn) {
+
+  static u8 buf[65536];
+
+  u64 h = 0xcbf29ce484222325ULL;
+  s32 fd = open(fn, O_RDONLY), len, i;
+
+  if (fd < 0) PFATAL("Unable to open '%s'", fn);
+
+  while ((len = read(fd, buf, sizeof(buf))) > 0)
+    for (i = 0; i < len; i++) h = (h ^ buf[i]) * 0x100000001b3ULL;
+
+  close(fd);
+
+  return h;
+
+}
+
+
+static u8* cache_obj(u64 key, u32 v) {
+
+  return alloc_printf("%s/%016llx%s.o", multi_cache, key, multi_sfx[v]);
+
+}
+
+
+/* Does the object fn reference the coverage map, i.e. went through a pass? */
+
+static u8 is_instrumented(u8* fn) {
+
+  struct stat st;
+  u8* buf;
+  s32 fd = open(fn, O_RDONLY);
+  u8 ret;
+
+  if (fd < 0 || fstat(fd, &st)) PFATAL("Unable to open '%s'", fn);
+
+  buf = ck_alloc(st.st_size + 1);
+
+  if (read(fd, buf, st.st_size) != st.st_size) PFATAL("Short read from '%s'", fn);
+
+  close(fd);
+
+  ret = memmem(buf, st.st_size, "__afl_area_ptr", 14) != NULL;
+  ck_free(buf);
+
+  return ret;
+
+}
+
+
+/* Variant v of the object fn: its cached variant, or fn itself if it was
+   built without a pass (assembly, prebuilt objects). An instrumented object
+   with no variant was compiled without AFL_MULTI; linking it as is would
+   give the variant binary the first variant's instrumentation. */
+
+static u8* variant_obj(u8* fn, u32 v) {
+
+  u8* obj = cache_obj(hash_file(fn), v);
+
+  if (!access(obj, R_OK)) return obj;
+
+  if (is_instrumented(fn))
+    FATAL("'%s' has no '%s' variant, rebuild it with AFL_MULTI set", fn,
+          multi_sfx[v]);
+
+  return fn;
+
+}
+
+
+static u8* abs_path(u8* path) {
+
+  u8 cwd[PATH_MAX];
+
+  if (path[0] == '/') return path;
+
+  if (!getcwd((char*)cwd, sizeof(cwd))) PFATAL("getcwd() failed");
+
+  return alloc_printf("%s/%s", cwd, path);
+
+}
+
+
+/* Working dir of the pass of variant v. Passes keep state in their cwd
+   (br_pass: br_cnt, br_log), so each variant gets its own, shared by the
+   whole build. */
+
+static u8* multi_state(u32 v) {
+
+  u8* dir = alloc_printf("%s/state%s", multi_cache, multi_sfx[v]);
+
+  if (mkdir(dir, 0700) && errno != EEXIST)
+    PFATAL("Unable to create '%s'", dir);
+
+  return dir;
+
+}
+
+
+static void copy_file(u8* src, u8* dst) {
+
+  static u8 buf[65536];
+
+  s32 in = open(src, O_RDONLY), out, len;
+
+  if (in < 0) PFATAL("Unable to open '%s'", src);
+
+  out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+  if (out < 0) PFATAL("Unable to create '%s'", dst);
+
+  while ((len = read(in, buf, sizeof(buf))) > 0)
+    if (write(out, buf, len) != len) PFATAL("Short write to '%s'", dst);
+
+  close(in);
+  close(out);
+
+}
+
+
+/* Instrument the bitcode in with the pass of variant v and lower it to the
+   object dst. Only the code generation flags of the original command are
+   kept; sanitizers already ran when the bitcode was made. */
+
+static u8** variant_params(u32 v, u8* in, u8* dst) {
+
+  u8** params = ck_alloc((cc_par_cnt + 16) * sizeof(u8*));
+  u32 i, n = 0;
+
+  params[n++] = cc_params[0];
+  params[n++] = "-Qunused-arguments";
+  params[n++] = "-Xclang";
+  params[n++] = "-load";
+  params[n++] = "-Xclang";
+  params[n++] = alloc_printf("%s/afl-llvm-pass.so", multi_dir[v]);
+
+  for (i = 1; i < cc_par_cnt; i++) {
+
+    u8* cur = cc_params[i];
+
+    if (!strcmp(cur, "-mllvm") && i + 1 < cc_par_cnt) {
+      params[n++] = cur;
+      params[n++] = cc_params[++i];
+      continue;
+    }
+
+    if (!strcmp(cur, "-Xclang")) {
+      i++;
+      continue;
+    }
+
+    if (!strncmp(cur, "-fsanitize", 10) || !strncmp(cur, "-fno-sanitize", 13))
+      continue;
+
+    if (cur[0] == '-' && cur[1] && strchr("fmOg", cur[1])) params[n++] = cur;
+
+  }
+
+  params[n++] = "-c";
+  params[n++] = "-x";
+  params[n++] = "ir";
+  params[n++] = in;
+  params[n++] = "-o";
+  params[n++] = dst;
+  params[n] = NULL;
+
+  return params;
+
+}
+
+
+/* AFL_MULTI compile: parse and optimize the source once into bitcode, then
+   run every variant's pass on it. The first variant's object becomes the -o
+   output; the others go to the cache under the hash of that object, where
+   the link step finds them. */
+
+static s32 multi_compile(void) {
+
+  u8** params = ck_alloc((cc_par_cnt + 2) * sizeof(u8*));
+  u8 *out = abs_path(cc_params[out_idx]), *tmp;
+  pid_t pid[MULTI_MAX];
+  s32 lock_fd, status, cur;
+  u32 i, n = 0, v;
+  u64 key;
+
+  for (i = 0; i < cc_par_cnt; i++)
+    if (i < load_idx || i >= load_idx + 4) params[n++] = cc_params[i];
+
+  params[n++] = "-emit-llvm";
+  params[n] = NULL;
+
+  status = run_params(params, NULL, NULL);
+
+  if (status) return status;
+
+  /* Passes number their sites from state in their cwd, so one translation
+     unit gets all its variants before the next one starts; that keeps the
+     ids of e.g. the _br and _br_fast variants in step under make -j. */
+
+  lock_fd = open(alloc_printf("%s/lock", multi_cache), O_RDWR | O_CREAT, 0600);
+
+  if (lock_fd < 0) PFATAL("Unable to open the AFL_MULTI lock");
+
+  flock(lock_fd, LOCK_EX);
+
+  tmp = alloc_printf("%s.multi", out);
+  status = run_params(variant_params(0, out, tmp), multi_state(0), NULL);
+
+  if (!status) {
+
+    key = hash_file(tmp);
+
+    for (v = 1; v < multi_cnt; v++)
+      pid[v] = spawn_params(variant_params(v, out, cache_obj(key, v)),
+                            multi_state(v), NULL);
+
+    for (v = 1; v < multi_cnt; v++)
+      if ((cur = wait_params(pid[v])) && !status) status = cur;
+
+  }
+
+  flock(lock_fd, LOCK_UN);
+  close(lock_fd);
+
+  if (status) {
+    unlink(tmp);
+    unlink(out);
+    return status;
+  }
+
+  if (rename(tmp, out)) PFATAL("Unable to rename '%s'", tmp);
+
+  return 0;
+
+}
+
+
+/* Variant v of the archive at path: a copy with every instrumented member
+   swapped for its cached variant. Returns path if no member has one. */
+
+static u8* multi_archive(u8* path, u32 v) {
+
+  u8 *ar = getenv("AR") ? (u8*)getenv("AR") : (u8*)"ar";
+  u8 *src = abs_path(path);
+  u8 *dst = alloc_printf("%s/%016llx%s.a", multi_cache, hash_file(src),
+                         multi_sfx[v]);
+  u8 *dir, *list, *tmp, **params, line[PATH_MAX];
+  u32 cnt = 0, swapped = 0, i;
+  FILE* f;
+
+  if (!access(dst, R_OK)) return dst;
+
+  dir = alloc_printf("%s/ar.%d", multi_cache, getpid());
+  list = alloc_printf("%s.list", dir);
+
+  if (mkdir(dir, 0700) && errno != EEXIST) PFATAL("Unable to create '%s'", dir);
+
+  params = ck_alloc(4 * sizeof(u8*));
+  params[0] = ar;
+  params[1] = "t";
+  params[2] = src;
+
+  if (run_params(params, NULL, list)) FATAL("Unable to list '%s'", src);
+
+  params[1] = "x";
+
+  if (run_params(params, dir, NULL)) FATAL("Unable to extract '%s'", src);
+
+  f = fopen(list, "r");
+
+  if (!f) PFATAL("Unable to open '%s'", list);
+
+  /* members keep their order; ar x leaves one copy of duplicate names */
+
+  params[1] = "rcs";
+  params[2] = tmp = alloc_printf("%s.%d", dst, getpid());
+
+  while (fgets((char*)line, sizeof(line), f)) {
+
+    u8 *member, *obj;
+
+    line[strcspn((char*)line, "\n")] = 0;
+    if (!line[0]) continue;
+
+    member = alloc_printf("%s/%s", dir, line);
+    obj = variant_obj(member, v);
+
+    if (obj != member) {
+      copy_file(obj, member);
+      swapped++;
+    }
+
+    params = ck_realloc(params, (cnt + 5) * sizeof(u8*));
+    params[3 + cnt++] = ck_strdup(line);
+
   }
 
+  fclose(f);
+  params[3 + cnt] = NULL;
+
+  unlink(tmp);
+
+  if (swapped && run_params(params, dir, NULL))
+    FATAL("Unable to create '%s'", tmp);
+
+  for (i = 0; i < cnt; i++)
+    unlink(alloc_printf("%s/%s", dir, params[3 + i]));
+
+  rmdir(dir);
+  unlink(list);
+
+  if (!swapped) return path;
+
+  if (rename(tmp, dst)) PFATAL("Unable to rename '%s'", tmp);
+
+  return dst;
+
+}
+
+
+/* AFL_MULTI link: link the -o output as usual, then <output><suffix> for
+   every variant, with each object and archive swapped for its variant. */
+
+static s32 multi_link(void) {
+
+  u8 *out = cc_params[out_idx];
+  s32 status = run_params(cc_params, NULL, NULL);
+  u32 v, i;
+
+  if (status) return status;
+
+  for (v = 0; v < multi_cnt; v++) {
+
+    u8** params;
+
+    if (!*multi_sfx[v]) continue;
+
+    params = ck_alloc((cc_par_cnt + 1) * sizeof(u8*));
+
+    for (i = 0; i < cc_par_cnt; i++) {
+
+      u8* cur = cc_params[i];
+      u32 len = strlen(cur);
+
+      if (i == out_idx)
+        cur = alloc_printf("%s%s", out, multi_sfx[v]);
+      else if (i == rt_idx)
+        cur = alloc_printf("%s%s", multi_dir[v], cur + strlen(obj_path));
+      else if (v && cur[0] != '-' && len > 2 && !access(cur, R_OK)) {
+
+        if (!strcmp(cur + len - 2, ".o")) cur = variant_obj(cur, v);
+        else if (!strcmp(cur + len - 2, ".a")) cur = multi_archive(cur, v);
+
+      }
+
+      params[i] = cur;
+
+    }
+
+    status = run_params(params, NULL, NULL);
+
+    if (status) return status;
+
+  }
+
+  return 0;
+
+}
+
+
+/* AFL_MULTI compile and link in one call (configure probes, small tools):
+   compile each source on its own into an object in the cache, then link
+   the objects. */
+
+static s32 multi_build(void) {
+
+  u8 **orig = cc_params, **obj = ck_alloc(cc_par_cnt * sizeof(u8*));
+  u32 orig_cnt = cc_par_cnt, i, j;
+  s32 orig_out = out_idx, status = 0;
+
+  for (i = 0; i < orig_cnt && !status; i++) {
+
+    if (i == orig_out || !is_source(orig[i]) || is_asm(orig[i])) continue;
+
+    cc_params = ck_alloc((orig_cnt + 2) * sizeof(u8*));
+    cc_par_cnt = 0;
+
+    for (j = 0; j < orig_cnt; j++) {
+
+      if (j != i && j != orig_out && is_source(orig[j]) && !is_asm(orig[j]))
+        continue;
+
+      if (j == orig_out) out_idx = cc_par_cnt;
+      cc_params[cc_par_cnt++] = orig[j];
+
+    }
+
+    obj[i] = alloc_printf("%s/build.%d.%u.o", multi_cache, getpid(), i);
+    cc_params[out_idx] = obj[i];
+    cc_params[cc_par_cnt++] = "-c";
+    cc_params[cc_par_cnt] = NULL;
+
+    status = multi_compile();
+
+  }
+
+  cc_params = orig;
+  cc_par_cnt = orig_cnt;
+  out_idx = orig_out;
+
+  if (!status) {
+
+    /* the objects take the place of the sources; -x would still apply */
+
+    for (i = 0; i < cc_par_cnt; i++)
+      if (obj[i]) cc_params[i] = obj[i];
+      else if (!strcmp(cc_params[i], "-x") && i + 1 < cc_par_cnt)
+        cc_params[i + 1] = "none";
+
+    status = multi_link();
+
+  }
+
+  for (i = 0; i < orig_cnt; i++)
+    if (obj[i]) unlink(obj[i]);
+
+  return status;
+
+}
+
+
+/* Compiles and links without -o get the name the compiler would pick. */
+
+static void multi_out(void) {
+
+  u8 *name, *dot;
+
+  if (out_idx >= 0 || pre_set || shared_set) return;
+
+  if (c_set) {
+
+    if (!src_cnt) return;
+
+    if (src_cnt > 1)
+      FATAL("AFL_MULTI compiles one source per call when -o is not given");
+
+    name = strrchr(src_name, '/');
+    name = ck_strdup(name ? name + 1 : src_name);
+    dot = strrchr(name, '.');
+    *dot = 0;
+    name = alloc_printf("%s.o", name);
+
+  } else if (maybe_linking) name = "a.out";
+  else return;
+
+  cc_params[cc_par_cnt++] = "-o";
+  out_idx = cc_par_cnt;
+  cc_params[cc_par_cnt++] = name;
   cc_params[cc_par_cnt] = NULL;
 
 }
@@ -337,7 +1014,10 @@ int main(int argc, char** argv) {
          "an LLVM pass and tends to offer improved performance with slow programs.\n\n"
 
          "You can specify custom next-stage toolchain via AFL_CC and AFL_CXX. Setting\n"
-         "AFL_HARDEN enables hardening optimizations in the compiled code.\n\n",
+         "AFL_HARDEN enables hardening optimizations in the compiled code. Setting\n"
+         "AFL_TAINT builds the DataFlowSanitizer taint flavour instead. Setting\n"
+         "AFL_MULTI=<suffix>=<dir>,... builds one binary per instrumentation pass\n"
+         "from a single build, caching objects in AFL_MULTI_CACHE.\n\n",
          BIN_PATH, BIN_PATH);
 
     exit(1);
@@ -345,10 +1025,29 @@ int main(int argc, char** argv) {
   }
 
 
-  find_obj(argv[0]);
+  if (getenv("AFL_MULTI")) parse_multi(getenv("AFL_MULTI"));
+  else find_obj(argv[0]);
 
   edit_params(argc, argv);
 
+  /* AFL_MULTI handles compiles, links and both in one call; -E, -S and
+     assembly-only compiles have nothing to instrument and run as usual.
+     Shared objects are linked once, with the first variant's objects. */
+
+  if (multi_cnt && !pre_set) {
+
+    multi_out();
+
+    if (c_set && src_cnt) exit(multi_compile());
+
+    if (shared_set)
+      WARNF("AFL_MULTI links '%s' with the first variant only",
+            out_idx >= 0 ? cc_params[out_idx] : (u8*)"the shared object");
+
+    if (maybe_linking) exit(src_cnt ? multi_build() : multi_link());
+
+  }
+
   execvp(cc_params[0], (char**)cc_params);
 
   FATAL("Oops, failed to execute '%s' - check your PATH", cc_params[0]);
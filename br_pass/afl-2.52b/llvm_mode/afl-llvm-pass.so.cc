@@ -33,13 +33,20 @@
 #include <unistd.h>
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include <string>
+#include <map>
+#include <set>
+#include <sstream>
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 using namespace llvm;
 using namespace std;
@@ -77,6 +84,128 @@ std::string string_to_hex(const std::string& input)
     return output;
 }
 
+/* Number of instructions dominated by each block of the function. */
+
+static void dom_sizes(DominatorTree &DT, std::map<BasicBlock*, unsigned> &dom_size) {
+  for (auto *N : post_order(DT.getRootNode())) {
+    unsigned size = N->getBlock()->size();
+    for (auto *C : *N)
+      size += dom_size[C->getBlock()];
+    dom_size[N->getBlock()] = size;
+  }
+}
+
+/* Static reward of taking the edge BB -> Succ: the instructions that can only
+   be reached through it, i.e. the dominator subtree of Succ when the edge
+   dominates Succ. */
+
+static unsigned edge_reward(BasicBlock *BB, BasicBlock *Succ, DominatorTree &DT,
+                            std::map<BasicBlock*, unsigned> &dom_size) {
+  if (!DT.dominates(BasicBlockEdge(BB, Succ), Succ))
+    return 0;
+  return dom_size[Succ];
+}
+
+/* br_log suffix with the rewards of the two outcomes of a compare. Outcome 1
+   is the one log_br* records as 1 (the predicate holds, or the operands are
+   equal for EQ/NE), so eq_first swaps the successors of an NE compare. */
+
+static std::string cmp_reward(Value *cond, bool eq_first, DominatorTree &DT,
+                              std::map<BasicBlock*, unsigned> &dom_size) {
+  unsigned reward_1 = 0, reward_2 = 0;
+  for (User *U : cond->users()) {
+    BranchInst *br_inst = dyn_cast<BranchInst>(U);
+    if (!br_inst || !br_inst->isConditional())
+      continue;
+    BasicBlock *BB = br_inst->getParent();
+    reward_1 = edge_reward(BB, br_inst->getSuccessor(eq_first ? 1 : 0), DT, dom_size);
+    reward_2 = edge_reward(BB, br_inst->getSuccessor(eq_first ? 0 : 1), DT, dom_size);
+    break;
+  }
+  std::ostringstream out;
+  out << " reward_1 " << reward_1 << " reward_2 " << reward_2;
+  return out.str();
+}
+
+/* strcmp/strncmp results feed an icmp against 0; outcome 1 is equal strings. */
+
+static std::string str_reward(CallInst *call_inst, DominatorTree &DT,
+                              std::map<BasicBlock*, unsigned> &dom_size) {
+  for (User *U : call_inst->users()) {
+    ICmpInst *icmp = dyn_cast<ICmpInst>(U);
+    if (!icmp || !icmp->isEquality())
+      continue;
+    ConstantInt *zero = dyn_cast<ConstantInt>(icmp->getOperand(1));
+    if (!zero || !zero->isZero())
+      continue;
+    return cmp_reward(icmp, icmp->getPredicate() == ICmpInst::ICMP_NE, DT, dom_size);
+  }
+  return " reward_1 0 reward_2 0";
+}
+
+/* Can V decide a branch direction: the condition of a conditional branch,
+   switch, or select (a branch if-converted by SimplifyCFG)? Logical ops,
+   casts and phis of it are followed. Values that escape the function
+   (returned, passed to a call, stored) count too: the caller of a helper
+   like is_magic(x) branches on them. Only compares used in arithmetic
+   alone are no branch crack() can target. */
+
+static bool feeds_branch(Value *V, std::set<Value*> &seen) {
+  if (!seen.insert(V).second)
+    return false;
+  for (User *U : V->users()) {
+    if (BranchInst *br_inst = dyn_cast<BranchInst>(U)) {
+      if (br_inst->isConditional())
+        return true;
+    }
+    else if (isa<SwitchInst>(U) || isa<ReturnInst>(U) || isa<StoreInst>(U) ||
+             isa<CallInst>(U) || isa<InvokeInst>(U))
+      return true;
+    else if (SelectInst *sel = dyn_cast<SelectInst>(U)) {
+      if (sel->getCondition() == V)
+        return true;
+      /* select i1 a, b, false is a && b */
+      if (sel->getType()->isIntegerTy(1) && feeds_branch(sel, seen))
+        return true;
+    }
+    else if (isa<PHINode>(U) || isa<CastInst>(U) ||
+             (isa<BinaryOperator>(U) && U->getType()->isIntegerTy(1))) {
+      if (feeds_branch(U, seen))
+        return true;
+    }
+  }
+  return false;
+}
+
+/* Wrap the runtime call of compare br_id into
+
+     if (__afl_br_hits[br_id] < budget && __afl_area_ptr[br_id] != 3) {
+       __afl_br_hits[br_id]++;
+       call;
+     }
+
+   so a compare in a loop stops paying for a call per iteration once it has
+   used up its budget for this exec or has seen both directions. */
+
+static void budget_call(CallInst *call, unsigned br_id, unsigned budget,
+                        GlobalVariable *map_ptr, GlobalVariable *hits) {
+  LLVMContext &C = call->getContext();
+  IntegerType *Int8Ty = IntegerType::getInt8Ty(C);
+  IntegerType *Int32Ty = IntegerType::getInt32Ty(C);
+  IRBuilder<> IRB(call);
+  Value *idx[] = {ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, br_id)};
+  Value *hit_ptr = IRB.CreateGEP(hits, idx);
+  Value *hit = IRB.CreateLoad(hit_ptr);
+  Value *map = IRB.CreateLoad(map_ptr);
+  Value *state = IRB.CreateLoad(IRB.CreateGEP(map, ConstantInt::get(Int32Ty, br_id)));
+  Value *go = IRB.CreateAnd(IRB.CreateICmpULT(hit, ConstantInt::get(Int8Ty, budget)),
+                            IRB.CreateICmpNE(state, ConstantInt::get(Int8Ty, 3)));
+  Instruction *then = SplitBlockAndInsertIfThen(go, call, false);
+  IRB.SetInsertPoint(then);
+  IRB.CreateStore(IRB.CreateAdd(hit, ConstantInt::get(Int8Ty, 1)), hit_ptr);
+  call->moveBefore(then);
+}
+
 bool AFLCoverage::runOnModule(Module &M) {
 
   LLVMContext &C = M.getContext();
@@ -112,6 +241,54 @@ bool AFLCoverage::runOnModule(Module &M) {
   FunctionType *logFuncType_4 = FunctionType::get(retType, paramTypes_4, false);
   Constant *log_br64 = (&M)->getOrInsertFunction("log_br64", logFuncType_4);
 
+  /* Taint flavour (AFL_TAINT): compares are reported to __taint_cmp* of
+     afl-llvm-taint-rt.o instead, which records the input offsets that reach
+     their operands under DataFlowSanitizer. */
+
+  bool taint_mode = getenv("AFL_TAINT") != NULL;
+
+  std::vector<Type*> taintTypes_8 = {Int32Ty, Int8Ty, Int8Ty};
+  Constant *taint_cmp8 = (&M)->getOrInsertFunction("__taint_cmp8", FunctionType::get(retType, taintTypes_8, false));
+
+  std::vector<Type*> taintTypes_16 = {Int32Ty, Int16Ty, Int16Ty};
+  Constant *taint_cmp16 = (&M)->getOrInsertFunction("__taint_cmp16", FunctionType::get(retType, taintTypes_16, false));
+
+  std::vector<Type*> taintTypes_32 = {Int32Ty, Int32Ty, Int32Ty};
+  Constant *taint_cmp32 = (&M)->getOrInsertFunction("__taint_cmp32", FunctionType::get(retType, taintTypes_32, false));
+
+  std::vector<Type*> taintTypes_64 = {Int32Ty, Int64Ty, Int64Ty};
+  Constant *taint_cmp64 = (&M)->getOrInsertFunction("__taint_cmp64", FunctionType::get(retType, taintTypes_64, false));
+
+  std::vector<Type*> taintTypes_str = {Int32Ty, Int8Ptr, Int8Ptr};
+  Constant *taint_strcmp = (&M)->getOrInsertFunction("__taint_strcmp", FunctionType::get(retType, taintTypes_str, false));
+
+  std::vector<Type*> taintTypes_strn = {Int32Ty, Int8Ptr, Int8Ptr, Int32Ty};
+  Constant *taint_strncmp = (&M)->getOrInsertFunction("__taint_strncmp", FunctionType::get(retType, taintTypes_strn, false));
+
+  /* Input reads are redirected to the labeling wrappers of the runtime. */
+
+  std::map<std::string, std::string> taint_inputs = {
+    {"read", "__taint_read"}, {"pread", "__taint_pread"},
+    {"pread64", "__taint_pread"}, {"fread", "__taint_fread"},
+    {"fgetc", "__taint_fgetc"}, {"getc", "__taint_fgetc"},
+    {"_IO_getc", "__taint_fgetc"}};
+
+  /* Compares that decide no branch are skipped unless AFL_BR_ALL is set. */
+
+  bool all_cmps = getenv("AFL_BR_ALL") != NULL;
+
+  /* Per-exec call budget of compares inside loops, see BR_SITE_BUDGET. */
+
+  char* site_budget_str = getenv("AFL_BR_SITE_BUDGET");
+  unsigned int site_budget = BR_SITE_BUDGET;
+
+  if (site_budget_str &&
+      (sscanf(site_budget_str, "%u", &site_budget) != 1 || site_budget > 255))
+    FATAL("Bad value of AFL_BR_SITE_BUDGET (must be between 0 and 255)");
+
+  if (taint_mode)
+    site_budget = 0;
+
   /* Show a banner */
 
   char be_quiet = 0;
@@ -146,6 +323,10 @@ bool AFLCoverage::runOnModule(Module &M) {
       M, Int32Ty, false, GlobalValue::ExternalLinkage, 0, "__afl_prev_loc",
       0, GlobalVariable::GeneralDynamicTLSModel, 0, false);
 
+  GlobalVariable *AFLBrHits =
+      new GlobalVariable(M, ArrayType::get(Int8Ty, MAP_SIZE), false,
+                         GlobalValue::ExternalLinkage, 0, "__afl_br_hits");
+
   int cnt = 0; 
   /* load cnt from local tmp file.*/
   ifstream ifile("br_cnt");
@@ -165,11 +346,33 @@ bool AFLCoverage::runOnModule(Module &M) {
   }
   /* Instrument all the things! */
 
-  int inst_blocks = 0;
+  int inst_blocks = 0, skipped = 0, budgeted = 0;
   for (auto &F : M){
+    if (F.isDeclaration())
+      continue;
+    /* Rewards of the branch directions, from the dominator tree. */
+    DominatorTree DT(F);
+    std::map<BasicBlock*, unsigned> dom_size;
+    dom_sizes(DT, dom_size);
+    /* Runtime calls of compares in loops, budgeted once the function is
+       done, as that splits blocks. */
+    LoopInfo LI(DT);
+    std::vector<std::pair<CallInst*, int>> loop_sites;
+    auto loop_site = [&](CallInst *call, int br_id) {
+      if (site_budget && LI.getLoopFor(call->getParent()))
+        loop_sites.push_back(std::make_pair(call, br_id));
+    };
     for (auto &BB : F){
       for (auto &I :BB){
         if(CmpInst* cmp_inst = dyn_cast<CmpInst>(&I)){
+          std::set<Value*> seen;
+          if(!all_cmps && isa<IntegerType>(cmp_inst->getOperand(0)->getType()) &&
+             !feeds_branch(cmp_inst, seen)){
+            /* the id stays taken, so ids match builds that instrument it */
+            cnt = cnt + 1;
+            skipped++;
+            continue;
+          }
           int cmp_opcode = 12;
           ICmpInst::Predicate pred = cmp_inst->getPredicate();
           string cmp_type;
@@ -242,6 +445,7 @@ bool AFLCoverage::runOnModule(Module &M) {
             }
             if(auto* type = dyn_cast<IntegerType>(op1->getType())){
               cnt = cnt + 1;
+              string reward = cmp_reward(cmp_inst, cmp_opcode == 7, DT, dom_size);
               if(constantLoc == 1)
                 constantVal = cast<ConstantInt>(op1)->getZExtValue();
               else if(constantLoc ==2)
@@ -253,8 +457,13 @@ bool AFLCoverage::runOnModule(Module &M) {
                       Value* br_id =  ConstantInt::get(Int32Ty, cnt);
                       Value* type =  ConstantInt::get(Int32Ty, cmp_opcode); 
                       Value* args[] = {br_id, type, op1, op2, constant_loc};   
-                      IRB.CreateCall(log_br8,args);
-                      log_file <<"$$$### br_id "<< cnt << " br_type " << cmp_opcode << " constant_loc " << constantLoc << " constant_val " << constantVal << " len 1\n";  
+                      if (taint_mode) {
+                        Value* taint_args[] = {br_id, op1, op2};
+                        IRB.CreateCall(taint_cmp8, taint_args);
+                      } else
+                        loop_site(IRB.CreateCall(log_br8,args), cnt);
+                      log_file <<"$$$### br_id "<< cnt << " br_type " << cmp_opcode << " constant_loc " << constantLoc << " constant_val " << constantVal << " len 1" << reward << "\n";  
+                      inst_blocks++;
                       }
                       break;
                   case 16:
@@ -263,8 +472,13 @@ bool AFLCoverage::runOnModule(Module &M) {
                       Value* br_id =  ConstantInt::get(Int32Ty, cnt);
                       Value* type =  ConstantInt::get(Int32Ty, cmp_opcode); 
                       Value* args[] = {br_id, type, op1, op2, constant_loc};  
-                      IRB.CreateCall(log_br16,args);
-                      log_file <<"$$$### br_id "<< cnt << " br_type " << cmp_opcode << " constant_loc " << constantLoc << " constant_val " << constantVal << " len 2\n";  
+                      if (taint_mode) {
+                        Value* taint_args[] = {br_id, op1, op2};
+                        IRB.CreateCall(taint_cmp16, taint_args);
+                      } else
+                        loop_site(IRB.CreateCall(log_br16,args), cnt);
+                      log_file <<"$$$### br_id "<< cnt << " br_type " << cmp_opcode << " constant_loc " << constantLoc << " constant_val " << constantVal << " len 2" << reward << "\n";  
+                      inst_blocks++;
                       }
                       break;
                   case 32:
@@ -273,8 +487,13 @@ bool AFLCoverage::runOnModule(Module &M) {
                       Value* br_id =  ConstantInt::get(Int32Ty, cnt);
                       Value* type =  ConstantInt::get(Int32Ty, cmp_opcode); 
                       Value* args[] = {br_id, type, op1, op2, constant_loc};  
-                      IRB.CreateCall(log_br32,args);
-                      log_file <<"$$$### br_id "<< cnt << " br_type " << cmp_opcode << " constant_loc " << constantLoc << " constant_val " << constantVal << " len 4\n";  
+                      if (taint_mode) {
+                        Value* taint_args[] = {br_id, op1, op2};
+                        IRB.CreateCall(taint_cmp32, taint_args);
+                      } else
+                        loop_site(IRB.CreateCall(log_br32,args), cnt);
+                      log_file <<"$$$### br_id "<< cnt << " br_type " << cmp_opcode << " constant_loc " << constantLoc << " constant_val " << constantVal << " len 4" << reward << "\n";  
+                      inst_blocks++;
                       }
                       break;
                   case 64:
@@ -283,8 +502,13 @@ bool AFLCoverage::runOnModule(Module &M) {
                       Value* br_id =  ConstantInt::get(Int32Ty, cnt);
                       Value* type =  ConstantInt::get(Int32Ty, cmp_opcode); 
                       Value* args[] = {br_id, type, op1, op2, constant_loc};  
-                      IRB.CreateCall(log_br64,args);
-                      log_file <<"$$$### br_id "<< cnt << " br_type " << cmp_opcode << " constant_loc " << constantLoc << " constant_val " << constantVal << " len 8\n";  
+                      if (taint_mode) {
+                        Value* taint_args[] = {br_id, op1, op2};
+                        IRB.CreateCall(taint_cmp64, taint_args);
+                      } else
+                        loop_site(IRB.CreateCall(log_br64,args), cnt);
+                      log_file <<"$$$### br_id "<< cnt << " br_type " << cmp_opcode << " constant_loc " << constantLoc << " constant_val " << constantVal << " len 8" << reward << "\n";  
+                      inst_blocks++;
                       }
                       break;
                   default:
@@ -297,24 +521,34 @@ bool AFLCoverage::runOnModule(Module &M) {
           Value* op1 = sw_inst->getCondition();
           if(auto* type = dyn_cast<IntegerType>(op1->getType())){
             SmallVector<ConstantInt*,128> *case_val_list=new SmallVector<ConstantInt*,128>();
+            /* Outcome 1 of a case is its successor, outcome 2 the default. */
+            SmallVector<unsigned,128> case_reward_list;
+            unsigned reward_2 = edge_reward(sw_inst->getParent(), sw_inst->getDefaultDest(), DT, dom_size);
             switch(type->getBitWidth()){
               case 8:
                   {
                   for(auto i = sw_inst->case_begin(), e = sw_inst->case_end(); i != e;++i){
                     ConstantInt* op2 = dyn_cast<ConstantInt>(i->getCaseValue()); 
                     case_val_list->push_back(op2); 
+                    case_reward_list.push_back(edge_reward(sw_inst->getParent(), i->getCaseSuccessor(), DT, dom_size));
                   }
                   int num_cases = sw_inst->getNumCases();
                   IRBuilder<> IRB(sw_inst--); 
                   for (int i = 0; i< num_cases;i++){
                     cnt = cnt + 1;
                     Value* op2 = case_val_list->pop_back_val();  
+                    unsigned reward_1 = case_reward_list.pop_back_val();
                     Value* br_id =  ConstantInt::get(Int32Ty, cnt);
                     Value* type =  ConstantInt::get(Int32Ty, 11); 
                     Value* constant_loc =  ConstantInt::get(Int32Ty, 2); 
                     Value* args[] = {br_id, type, op1, op2, constant_loc};  
-                    IRB.CreateCall(log_br8,args); 
-                    log_file <<"$$$### br_id "<< cnt << " br_type 11 constant_loc 2 constant_val " << cast<ConstantInt>(op2)->getZExtValue() << " len 1\n";  
+                    if (taint_mode) {
+                      Value* taint_args[] = {br_id, op1, op2};
+                      IRB.CreateCall(taint_cmp8, taint_args);
+                    } else
+                      loop_site(IRB.CreateCall(log_br8,args), cnt);
+                    log_file <<"$$$### br_id "<< cnt << " br_type 11 constant_loc 2 constant_val " << cast<ConstantInt>(op2)->getZExtValue() << " len 1 reward_1 " << reward_1 << " reward_2 " << reward_2 << "\n";  
+                    inst_blocks++;
                   }
                   }
                   break;
@@ -323,18 +557,25 @@ bool AFLCoverage::runOnModule(Module &M) {
                   for(auto i = sw_inst->case_begin(), e = sw_inst->case_end(); i != e;++i){
                     ConstantInt* op2 = dyn_cast<ConstantInt>(i->getCaseValue()); 
                     case_val_list->push_back(op2); 
+                    case_reward_list.push_back(edge_reward(sw_inst->getParent(), i->getCaseSuccessor(), DT, dom_size));
                   }
                   int num_cases = sw_inst->getNumCases();
                   IRBuilder<> IRB(sw_inst--); 
                   for (int i = 0; i< num_cases;i++){
                     cnt = cnt + 1;
                     Value* op2 = case_val_list->pop_back_val();  
+                    unsigned reward_1 = case_reward_list.pop_back_val();
                     Value* br_id =  ConstantInt::get(Int32Ty, cnt);
                     Value* type =  ConstantInt::get(Int32Ty, 11); 
                     Value* constant_loc =  ConstantInt::get(Int32Ty, 2); 
                     Value* args[] = {br_id, type, op1, op2, constant_loc};  
-                    IRB.CreateCall(log_br16,args); 
-                    log_file <<"$$$### br_id "<< cnt << " br_type 11 constant_loc 2 constant_val " << cast<ConstantInt>(op2)->getZExtValue() << " len 2\n";  
+                    if (taint_mode) {
+                      Value* taint_args[] = {br_id, op1, op2};
+                      IRB.CreateCall(taint_cmp16, taint_args);
+                    } else
+                      loop_site(IRB.CreateCall(log_br16,args), cnt);
+                    log_file <<"$$$### br_id "<< cnt << " br_type 11 constant_loc 2 constant_val " << cast<ConstantInt>(op2)->getZExtValue() << " len 2 reward_1 " << reward_1 << " reward_2 " << reward_2 << "\n";  
+                    inst_blocks++;
                   }
                   }
                   break;
@@ -343,18 +584,25 @@ bool AFLCoverage::runOnModule(Module &M) {
                   for(auto i = sw_inst->case_begin(), e = sw_inst->case_end(); i != e;++i){
                     ConstantInt* op2 = dyn_cast<ConstantInt>(i->getCaseValue()); 
                     case_val_list->push_back(op2); 
+                    case_reward_list.push_back(edge_reward(sw_inst->getParent(), i->getCaseSuccessor(), DT, dom_size));
                   }
                   int num_cases = sw_inst->getNumCases();
                   IRBuilder<> IRB(sw_inst--); 
                   for (int i = 0; i< num_cases;i++){
                     cnt = cnt + 1;
                     Value* op2 = case_val_list->pop_back_val();  
+                    unsigned reward_1 = case_reward_list.pop_back_val();
                     Value* br_id =  ConstantInt::get(Int32Ty, cnt);
                     Value* type =  ConstantInt::get(Int32Ty, 11); 
                     Value* constant_loc =  ConstantInt::get(Int32Ty, 2); 
                     Value* args[] = {br_id, type, op1, op2, constant_loc};  
-                    IRB.CreateCall(log_br32,args); 
-                    log_file <<"$$$### br_id "<< cnt << " br_type 11 constant_loc 2 constant_val " << cast<ConstantInt>(op2)->getZExtValue() << " len 4\n";  
+                    if (taint_mode) {
+                      Value* taint_args[] = {br_id, op1, op2};
+                      IRB.CreateCall(taint_cmp32, taint_args);
+                    } else
+                      loop_site(IRB.CreateCall(log_br32,args), cnt);
+                    log_file <<"$$$### br_id "<< cnt << " br_type 11 constant_loc 2 constant_val " << cast<ConstantInt>(op2)->getZExtValue() << " len 4 reward_1 " << reward_1 << " reward_2 " << reward_2 << "\n";  
+                    inst_blocks++;
                   }
                   }
                   break;
@@ -363,18 +611,25 @@ bool AFLCoverage::runOnModule(Module &M) {
                   for(auto i = sw_inst->case_begin(), e = sw_inst->case_end(); i != e;++i){
                     ConstantInt* op2 = dyn_cast<ConstantInt>(i->getCaseValue()); 
                     case_val_list->push_back(op2); 
+                    case_reward_list.push_back(edge_reward(sw_inst->getParent(), i->getCaseSuccessor(), DT, dom_size));
                   }
                   int num_cases = sw_inst->getNumCases();
                   IRBuilder<> IRB(sw_inst--); 
                   for (int i = 0; i< num_cases;i++){
                     cnt = cnt + 1;
                     Value* op2 = case_val_list->pop_back_val();  
+                    unsigned reward_1 = case_reward_list.pop_back_val();
                     Value* br_id =  ConstantInt::get(Int32Ty, cnt);
                     Value* type =  ConstantInt::get(Int32Ty, 11); 
                     Value* constant_loc =  ConstantInt::get(Int32Ty, 2); 
                     Value* args[] = {br_id, type, op1, op2, constant_loc};  
-                    IRB.CreateCall(log_br64,args); 
-                    log_file <<"$$$### br_id "<< cnt << " br_type 11 constant_loc 2 constant_val " << cast<ConstantInt>(op2)->getZExtValue() << " len 8\n";  
+                    if (taint_mode) {
+                      Value* taint_args[] = {br_id, op1, op2};
+                      IRB.CreateCall(taint_cmp64, taint_args);
+                    } else
+                      loop_site(IRB.CreateCall(log_br64,args), cnt);
+                    log_file <<"$$$### br_id "<< cnt << " br_type 11 constant_loc 2 constant_val " << cast<ConstantInt>(op2)->getZExtValue() << " len 8 reward_1 " << reward_1 << " reward_2 " << reward_2 << "\n";  
+                    inst_blocks++;
                   }
                   }
                   break;
@@ -385,8 +640,13 @@ bool AFLCoverage::runOnModule(Module &M) {
         }        
         else if(auto* call_inst = dyn_cast<CallInst>(&I)){
           if(Function *fun = call_inst->getCalledFunction()){
+            if(taint_mode && taint_inputs.count(fun->getName().str())){
+              call_inst->setCalledFunction((&M)->getOrInsertFunction(taint_inputs[fun->getName().str()], fun->getFunctionType()));
+              continue;
+            }
             if(fun->getName().equals("strcmp")){
               cnt = cnt + 1;
+              string reward = str_reward(call_inst, DT, dom_size);
               Value* br_id =  ConstantInt::get(Int32Ty, cnt);
               Value* op1 = call_inst->getArgOperand(0); 
               Value* op2 = call_inst->getArgOperand(1);
@@ -398,10 +658,10 @@ bool AFLCoverage::runOnModule(Module &M) {
                 std::string tmp;
                 if ( auto hope1 = dyn_cast<ConstantDataArray>((cast<GlobalVariable>(hope->getOperand(0)))->getInitializer())){
 		  tmp = string_to_hex(hope1->getRawDataValues());
-                  log_file <<"$$$### br_id "<< cnt << " br_type 10 constant_loc 1 constant_val " << tmp << " len " << tmp.length()/2 << "\n";  
+                  log_file <<"$$$### br_id "<< cnt << " br_type 10 constant_loc 1 constant_val " << tmp << " len " << tmp.length()/2 << reward << "\n";  
                 }
                 else if( auto hope1 = dyn_cast<ConstantAggregateZero>((cast<GlobalVariable>(hope->getOperand(0)))->getInitializer())){ 
-                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 1 constant_val 00 len 0\n"; 
+                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 1 constant_val 00 len 0" << reward << "\n"; 
                 }
               }
               else if(auto hope = dyn_cast<ConstantExpr>(op2)){
@@ -409,23 +669,30 @@ bool AFLCoverage::runOnModule(Module &M) {
                 std::string tmp;
                 if ( auto hope1 = dyn_cast<ConstantDataArray>((cast<GlobalVariable>(hope->getOperand(0)))->getInitializer())){
 		  tmp = string_to_hex(hope1->getRawDataValues());
-                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 2 constant_val " << tmp << " len " << tmp.length()/2 << "\n";  
+                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 2 constant_val " << tmp << " len " << tmp.length()/2 << reward << "\n";  
                 }
                 // len 0 means zero initizlization.
                 else if( auto hope1 = dyn_cast<ConstantAggregateZero>((cast<GlobalVariable>(hope->getOperand(0)))->getInitializer())){  
-                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 2 constant_val 00 len 0\n"; 
+                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 2 constant_val 00 len 0" << reward << "\n"; 
                 }
               }
               // constant_loc 0 means no magic constant
               else
-                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 0 constant_val 00 len 0 \n";  
+                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 0 constant_val 00 len 0" << reward << "\n";  
               IRBuilder<> IRB(call_inst->getNextNode()); 
-              Value* args[] = {br_id, type, ret, constant_loc};
-              IRB.CreateCall(log_strcmp, args);
+              inst_blocks++;
+              if (taint_mode) {
+                Value* taint_args[] = {br_id, op1, op2};
+                IRB.CreateCall(taint_strcmp, taint_args);
+              } else {
+                Value* args[] = {br_id, type, ret, constant_loc};
+                IRB.CreateCall(log_strcmp, args);
+              }
             
             }
             if(fun->getName().equals("strncmp")){
               cnt = cnt + 1;
+              string reward = str_reward(call_inst, DT, dom_size);
               Value* br_id =  ConstantInt::get(Int32Ty, cnt);
               Value* op1 = call_inst->getArgOperand(0); 
               Value* op2 = call_inst->getArgOperand(1);
@@ -438,32 +705,41 @@ bool AFLCoverage::runOnModule(Module &M) {
                 std::string tmp;
                 if ( auto hope1 = dyn_cast<ConstantDataArray>((cast<GlobalVariable>(hope->getOperand(0)))->getInitializer())){
 		  tmp = string_to_hex(hope1->getRawDataValues());
-                  log_file<<"$$$### br_id "<< cnt << " br_type 12 constant_loc 1 constant_val " << tmp << " len " << tmp.length()/2 << "\n";  
+                  log_file<<"$$$### br_id "<< cnt << " br_type 12 constant_loc 1 constant_val " << tmp << " len " << tmp.length()/2 << reward << "\n";  
                 }
                 else if( auto hope1 = dyn_cast<ConstantAggregateZero>((cast<GlobalVariable>(hope->getOperand(0)))->getInitializer()))
-                  log_file<<"$$$### br_id "<< cnt << " br_type 12 constant_loc 1 constant_val 00 len 0\n"; 
+                  log_file<<"$$$### br_id "<< cnt << " br_type 12 constant_loc 1 constant_val 00 len 0" << reward << "\n"; 
               }
               else if(auto hope = dyn_cast<ConstantExpr>(op2)){
                 constant_loc =  ConstantInt::get(Int32Ty, 2);
                 std::string tmp;
                 if ( auto hope1 = dyn_cast<ConstantDataArray>((cast<GlobalVariable>(hope->getOperand(0)))->getInitializer())){
 		  tmp = string_to_hex(hope1->getRawDataValues());
-                  log_file<<"$$$### br_id "<< cnt << " br_type 12 constant_loc 2 constant_val " << tmp << " len " << tmp.length()/2 << "\n";  
+                  log_file<<"$$$### br_id "<< cnt << " br_type 12 constant_loc 2 constant_val " << tmp << " len " << tmp.length()/2 << reward << "\n";  
                 }
                 else if( auto hope1 = dyn_cast<ConstantAggregateZero>((cast<GlobalVariable>(hope->getOperand(0)))->getInitializer()))
-                  log_file<<"$$$### br_id "<< cnt << " br_type 12 constant_loc 2 constant_val 00 len 0\n"; 
+                  log_file<<"$$$### br_id "<< cnt << " br_type 12 constant_loc 2 constant_val 00 len 0" << reward << "\n"; 
               }
               // constant_loc 0 means no magic constant
               else
-                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 0 constant_val 00 len 0 \n";  
+                  log_file<<"$$$### br_id "<< cnt << " br_type 10 constant_loc 0 constant_val 00 len 0" << reward << "\n";  
               IRBuilder<> IRB(call_inst->getNextNode()); 
-              Value* args[] = {br_id, type, len, ret, constant_loc};
-              IRB.CreateCall(log_strncmp, args);
+              inst_blocks++;
+              if (taint_mode) {
+                Value* taint_args[] = {br_id, op1, op2, IRB.CreateZExtOrTrunc(len, Int32Ty)};
+                IRB.CreateCall(taint_strncmp, taint_args);
+              } else {
+                Value* args[] = {br_id, type, len, ret, constant_loc};
+                IRB.CreateCall(log_strncmp, args);
+              }
             }
           }
         }
       }  
     }
+    for (auto &site : loop_sites)
+      budget_call(site.first, site.second, site_budget, AFLMapPtr, AFLBrHits);
+    budgeted += loop_sites.size();
   }
   
   ofstream ofile("br_cnt");
@@ -478,8 +754,8 @@ bool AFLCoverage::runOnModule(Module &M) {
   if (!be_quiet) {
 
     if (!inst_blocks) WARNF("No instrumentation targets found.");
-    else OKF("Br %u Instrume//nted %u locations (%s mode, ratio %u%%).",
-             cnt, inst_blocks, getenv("AFL_HARDEN") ? "hardened" :
+    else OKF("Br %u Instrumented %u locations, %u in loops with a budget of %u calls, skipped %u compares deciding no branch (%s mode, ratio %u%%).",
+             cnt, inst_blocks, budgeted, site_budget, skipped, getenv("AFL_HARDEN") ? "hardened" :
              ((getenv("AFL_USE_ASAN") || getenv("AFL_USE_MSAN")) ?
               "ASAN/MSAN" : "non-hardened"), inst_ratio);
 
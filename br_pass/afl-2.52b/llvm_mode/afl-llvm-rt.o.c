@@ -53,12 +53,24 @@ u8* __afl_area_ptr = __afl_area_initial;
 
 __thread u32 __afl_prev_loc;
 
+/* Runtime calls made by each compare in a loop in this exec. The pass skips
+   the call once it reaches BR_SITE_BUDGET. */
+
+u8  __afl_br_hits[MAP_SIZE];
+
 
 /* Running in persistent mode? */
 
 static u8 is_persistent;
 
 
+/* Compare to stop at, from AFL_BR_TARGET. Once it has been evaluated the rest
+   of the run is wasted for crack, so the child _exit()s with BR_TARGET_EXIT,
+   skipping atexit handlers and stdio teardown. -1 runs to completion. */
+
+static s32 __afl_br_target = -1;
+
+
 /* SHM setup. */
 
 static void __afl_map_shm(void) {
@@ -134,6 +146,7 @@ static void __afl_start_forkserver(void) {
 
         close(FORKSRV_FD);
         close(FORKSRV_FD + 1);
+        memset(__afl_br_hits, 0, MAP_SIZE);
         return;
   
       }
@@ -189,6 +202,7 @@ int __afl_persistent_loop(unsigned int max_cnt) {
       memset(__afl_area_ptr, 0, MAP_SIZE);
       __afl_area_ptr[0] = 1;
       __afl_prev_loc = 0;
+      memset(__afl_br_hits, 0, MAP_SIZE);
     }
 
     cycle_cnt  = max_cnt;
@@ -205,6 +219,7 @@ int __afl_persistent_loop(unsigned int max_cnt) {
 
       __afl_area_ptr[0] = 1;
       __afl_prev_loc = 0;
+      memset(__afl_br_hits, 0, MAP_SIZE);
 
       return 1;
 
@@ -247,6 +262,10 @@ void __afl_manual_init(void) {
 
 __attribute__((constructor)) void __afl_auto_init(void) {
 
+  u8* br_target = getenv("AFL_BR_TARGET");
+
+  if (br_target) __afl_br_target = atoi(br_target);
+
   __afl_manual_init();
 
 }
@@ -317,14 +336,25 @@ void check_br8(int br_id, char op1, char op2, int constant_loc){
 }*/
 
 
+/* The check_br* hooks stop the child once they have reported the operands:
+   [1]/[2] the (low words of the) operands, [4] their width in bytes and
+   [5]/[6] the high words of 64 bit ones. */
+
+static void br_target_exit(void) {
+    if (__afl_br_target >= 0)
+        _exit(BR_TARGET_EXIT);
+    exit(0);
+}
+
 void check_br8(int br_id, char op1, char op2, int constant_loc){
     int target_br_id = ((int *)__afl_area_ptr)[0];
     if (br_id == target_br_id)
     {
             ((int *)__afl_area_ptr)[1] = (int)op1;
             ((int *)__afl_area_ptr)[2] = (int)op2;
+            ((int *)__afl_area_ptr)[4] = 1;
         ((int *)__afl_area_ptr)[3] = 12;
-        exit(0);
+        br_target_exit();
     }
     else
         return;
@@ -336,8 +366,9 @@ void check_br16(int br_id, short op1, short op2, int constant_loc){
     {
             ((int *)__afl_area_ptr)[1] = (int)op1;
             ((int *)__afl_area_ptr)[2] = (int)op2;
+            ((int *)__afl_area_ptr)[4] = 2;
         ((int *)__afl_area_ptr)[3] = 12;
-        exit(0);
+        br_target_exit();
     }
     else
         return;
@@ -349,8 +380,9 @@ void check_br32(int br_id, int op1, int op2, int constant_loc){
     {
             ((int *)__afl_area_ptr)[1] = (int)op1;
             ((int *)__afl_area_ptr)[2] = (int)op2;
+            ((int *)__afl_area_ptr)[4] = 4;
         ((int *)__afl_area_ptr)[3] = 12;
-        exit(0);
+        br_target_exit();
     }
     else
         return;
@@ -362,8 +394,11 @@ void check_br64(int br_id, long long int op1, long long int op2, int constant_lo
     {
             ((int *)__afl_area_ptr)[1] = (int)op1;
             ((int *)__afl_area_ptr)[2] = (int)op2;
+            ((int *)__afl_area_ptr)[5] = (int)(op1 >> 32);
+            ((int *)__afl_area_ptr)[6] = (int)(op2 >> 32);
+            ((int *)__afl_area_ptr)[4] = 8;
         ((int *)__afl_area_ptr)[3] = 12;
-        exit(0);
+        br_target_exit();
     }
     else
         return;
@@ -376,7 +411,7 @@ void check_strcmp(int br_id, int type, char *op1, char* op2,int ret, int constan
             ((int *)__afl_area_ptr)[1] = (int)(op1[0]);
             ((int *)__afl_area_ptr)[2] = (int)(op2[0]);
         ((int *)__afl_area_ptr)[3] = 12;
-        exit(0);
+        br_target_exit();
     }
     else
         return;
@@ -389,14 +424,14 @@ void check_strncmp(int br_id, int type, char *op1, char* op2,int len, int ret, i
         ((int *)__afl_area_ptr)[1] = (int)(op1[0]);
         ((int *)__afl_area_ptr)[2] = (int)(op2[0]);
         ((int *)__afl_area_ptr)[3] = 12;
-        exit(0);
+        br_target_exit();
     }
     else
         return;
 }
 
 
-void log_br8(int br_id, int type, char op1, char op2, int constant_loc){
+static void log_br8_state(int br_id, int type, char op1, char op2, int constant_loc){
     int br_dist = op1 - op2;
     char val = ((char *)__afl_area_ptr)[br_id];
     if (val==3)
@@ -495,7 +530,7 @@ void log_br8(int br_id, int type, char op1, char op2, int constant_loc){
 }
 
 
-void log_br16(int br_id, int type, short op1, short op2, int constant_loc){
+static void log_br16_state(int br_id, int type, short op1, short op2, int constant_loc){
     int br_dist = op1 - op2;
     char val = ((char *)__afl_area_ptr)[br_id];
     if (val==3)
@@ -593,7 +628,7 @@ void log_br16(int br_id, int type, short op1, short op2, int constant_loc){
     return;
 }
 
-void log_br32(int br_id, int type, int op1, int op2, int constant_loc){
+static void log_br32_state(int br_id, int type, int op1, int op2, int constant_loc){
     int br_dist = op1 - op2;
     char val = ((char *)__afl_area_ptr)[br_id];
     if (val==3)
@@ -691,7 +726,7 @@ void log_br32(int br_id, int type, int op1, int op2, int constant_loc){
     return;
 }
 
-void log_br64(int br_id, int type, long long op1, long long op2, int constant_loc){
+static void log_br64_state(int br_id, int type, long long op1, long long op2, int constant_loc){
     long long br_dist = op1 - op2;
     char val = ((char *)__afl_area_ptr)[br_id];
     if(val==3)
@@ -789,7 +824,7 @@ void log_br64(int br_id, int type, long long op1, long long op2, int constant_lo
     return;
 }
 
-void log_strcmp(int br_id, int type, int ret, int constant_loc){
+static void log_strcmp_state(int br_id, int type, int ret, int constant_loc){
     int br_dist = ret;
     char val = ((char *)__afl_area_ptr)[br_id];
     if(val==3)
@@ -811,7 +846,7 @@ void log_strcmp(int br_id, int type, int ret, int constant_loc){
     return;
 }
 
-void log_strncmp(int br_id, int type,int len, int ret, int constant_loc){
+static void log_strncmp_state(int br_id, int type,int len, int ret, int constant_loc){
     int br_dist = ret;
     char val = ((char *)__afl_area_ptr)[br_id];
     // use last 2 bits to save val
@@ -836,6 +871,46 @@ void log_strncmp(int br_id, int type,int len, int ret, int constant_loc){
     }
     return;
 }
+
+/* Entry points of the br pass: record the outcome, then stop if this is the
+   AFL_BR_TARGET compare. */
+
+void log_br8(int br_id, int type, char op1, char op2, int constant_loc){
+    log_br8_state(br_id, type, op1, op2, constant_loc);
+    if (br_id == __afl_br_target)
+        _exit(BR_TARGET_EXIT);
+}
+
+void log_br16(int br_id, int type, short op1, short op2, int constant_loc){
+    log_br16_state(br_id, type, op1, op2, constant_loc);
+    if (br_id == __afl_br_target)
+        _exit(BR_TARGET_EXIT);
+}
+
+void log_br32(int br_id, int type, int op1, int op2, int constant_loc){
+    log_br32_state(br_id, type, op1, op2, constant_loc);
+    if (br_id == __afl_br_target)
+        _exit(BR_TARGET_EXIT);
+}
+
+void log_br64(int br_id, int type, long long op1, long long op2, int constant_loc){
+    log_br64_state(br_id, type, op1, op2, constant_loc);
+    if (br_id == __afl_br_target)
+        _exit(BR_TARGET_EXIT);
+}
+
+void log_strcmp(int br_id, int type, int ret, int constant_loc){
+    log_strcmp_state(br_id, type, ret, constant_loc);
+    if (br_id == __afl_br_target)
+        _exit(BR_TARGET_EXIT);
+}
+
+void log_strncmp(int br_id, int type,int len, int ret, int constant_loc){
+    log_strncmp_state(br_id, type, len, ret, constant_loc);
+    if (br_id == __afl_br_target)
+        _exit(BR_TARGET_EXIT);
+}
+
 /*
 void log_br8(int br_id, int type, char op1, char op2, int constant_loc){
     fprintf(stderr, "###$$$ branch ID %d type %d op1 %d op2 %d len %d constant_loc %d\n", br_id, type, (int)op1, (int)op2, 8, constant_loc);
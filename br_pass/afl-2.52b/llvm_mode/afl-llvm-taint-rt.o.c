@@ -0,0 +1,323 @@
+/*
+   american fuzzy lop - LLVM taint inference runtime
+   -------------------------------------------------
+
+   Runtime for binaries built with AFL_TAINT=1. The pass redirects the input
+   reads of the program to the __taint_* wrappers below and reports every
+   instrumented compare through __taint_cmp*. Under DataFlowSanitizer, each
+   input offset gets its own label, so a single run tells which offsets flow
+   into the operands of each compare.
+
+   On exit, the result is written to $AFL_TAINT_OUT (default: taint_map), one
+   line per reached compare:
+
+     br_id: off1 off2 ...
+
+   Only the file named by $AFL_TAINT_INPUT is labeled (stdin when unset).
+
+*/
+
+#include "../config.h"
+#include "../types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <sanitizer/dfsan_interface.h>
+
+/* Input offsets beyond this one are left unlabeled. DFSan only has 2^16
+   labels and the unions made by the program share them with us. */
+
+#define TAINT_MAX_OFFSETS 4096
+
+static dfsan_label off_label[TAINT_MAX_OFFSETS];   /* Label of each offset     */
+static u32 label_off[1 << 16];                     /* Offset + 1 of base labels */
+static dfsan_label br_label[MAP_SIZE];             /* Union of operand labels  */
+
+static u8 visited[(1 << 16) / 8];                  /* Labels seen by expand()  */
+static dfsan_label stack[1 << 16];                 /* Work list of expand()    */
+
+static dev_t input_dev;                            /* Identity of the input    */
+static ino_t input_ino;
+static u8 input_set;
+
+
+/* Does fd refer to the input file? */
+
+static u8 is_input(int fd) {
+
+  struct stat st;
+
+  if (!input_set) return fd == 0;
+  if (fstat(fd, &st)) return 0;
+
+  return st.st_dev == input_dev && st.st_ino == input_ino;
+
+}
+
+
+/* Label len bytes at buf, which were read from input offset off. */
+
+static void taint_input(u8* buf, s64 off, s64 len) {
+
+  s64 i;
+
+  for (i = 0; i < len; i++) {
+
+    s64 cur = off + i;
+
+    if (cur < 0 || cur >= TAINT_MAX_OFFSETS) continue;
+
+    if (!off_label[cur]) {
+      off_label[cur] = dfsan_create_label("in", NULL);
+      label_off[off_label[cur]] = cur + 1;
+    }
+
+    dfsan_set_label(off_label[cur], buf + i, 1);
+
+  }
+
+}
+
+
+/* Input wrappers. The pass rewrites calls to the libc functions into these,
+   so the labels we set are not cleared by the stock DFSan wrappers. */
+
+ssize_t __dfsw___taint_read(int fd, void* buf, size_t count,
+                            dfsan_label fd_label, dfsan_label buf_label,
+                            dfsan_label count_label, dfsan_label* ret_label) {
+
+  off_t off = lseek(fd, 0, SEEK_CUR);
+  ssize_t ret = read(fd, buf, count);
+
+  if (ret > 0) {
+    dfsan_set_label(0, buf, ret);
+    if (off >= 0 && is_input(fd)) taint_input(buf, off, ret);
+  }
+
+  *ret_label = 0;
+  return ret;
+
+}
+
+
+ssize_t __dfsw___taint_pread(int fd, void* buf, size_t count, off_t off,
+                             dfsan_label fd_label, dfsan_label buf_label,
+                             dfsan_label count_label, dfsan_label pos_label,
+                             dfsan_label* ret_label) {
+
+  ssize_t ret = pread(fd, buf, count, off);
+
+  if (ret > 0) {
+    dfsan_set_label(0, buf, ret);
+    if (is_input(fd)) taint_input(buf, off, ret);
+  }
+
+  *ret_label = 0;
+  return ret;
+
+}
+
+
+size_t __dfsw___taint_fread(void* ptr, size_t size, size_t n, FILE* f,
+                            dfsan_label ptr_label, dfsan_label size_label,
+                            dfsan_label n_label, dfsan_label f_label,
+                            dfsan_label* ret_label) {
+
+  long off = ftell(f);
+  size_t ret = fread(ptr, size, n, f);
+
+  if (ret) {
+    dfsan_set_label(0, ptr, ret * size);
+    if (off >= 0 && is_input(fileno(f))) taint_input(ptr, off, ret * size);
+  }
+
+  *ret_label = 0;
+  return ret;
+
+}
+
+
+int __dfsw___taint_fgetc(FILE* f, dfsan_label f_label,
+                         dfsan_label* ret_label) {
+
+  long off = ftell(f);
+  int ret = fgetc(f);
+
+  *ret_label = 0;
+
+  if (ret != EOF && off >= 0 && off < TAINT_MAX_OFFSETS &&
+      is_input(fileno(f))) {
+
+    u8 c = ret;
+
+    taint_input(&c, off, 1);
+    *ret_label = dfsan_read_label(&c, 1);
+
+  }
+
+  return ret;
+
+}
+
+
+/* Compare hooks: remember which labels reached the operands of br_id. */
+
+static void taint_br(u32 br_id, dfsan_label l) {
+
+  if (!l || br_id >= MAP_SIZE) return;
+
+  br_label[br_id] = br_label[br_id] ? dfsan_union(br_label[br_id], l) : l;
+
+}
+
+
+void __dfsw___taint_cmp8(u32 br_id, u8 op1, u8 op2, dfsan_label id_label,
+                         dfsan_label l1, dfsan_label l2) {
+
+  taint_br(br_id, l1);
+  taint_br(br_id, l2);
+
+}
+
+
+void __dfsw___taint_cmp16(u32 br_id, u16 op1, u16 op2, dfsan_label id_label,
+                          dfsan_label l1, dfsan_label l2) {
+
+  taint_br(br_id, l1);
+  taint_br(br_id, l2);
+
+}
+
+
+void __dfsw___taint_cmp32(u32 br_id, u32 op1, u32 op2, dfsan_label id_label,
+                          dfsan_label l1, dfsan_label l2) {
+
+  taint_br(br_id, l1);
+  taint_br(br_id, l2);
+
+}
+
+
+void __dfsw___taint_cmp64(u32 br_id, u64 op1, u64 op2, dfsan_label id_label,
+                          dfsan_label l1, dfsan_label l2) {
+
+  taint_br(br_id, l1);
+  taint_br(br_id, l2);
+
+}
+
+
+/* String compares: the operands are the bytes up to the terminator, or up to
+   len for strncmp. */
+
+void __dfsw___taint_strcmp(u32 br_id, char* op1, char* op2,
+                           dfsan_label id_label, dfsan_label l1,
+                           dfsan_label l2) {
+
+  taint_br(br_id, dfsan_read_label(op1, strlen(op1)));
+  taint_br(br_id, dfsan_read_label(op2, strlen(op2)));
+
+}
+
+
+void __dfsw___taint_strncmp(u32 br_id, char* op1, char* op2, u32 len,
+                            dfsan_label id_label, dfsan_label l1,
+                            dfsan_label l2, dfsan_label len_label) {
+
+  taint_br(br_id, dfsan_read_label(op1, strnlen(op1, len)));
+  taint_br(br_id, dfsan_read_label(op2, strnlen(op2, len)));
+  taint_br(br_id, len_label);
+
+}
+
+
+/* Write the offsets behind label l, in ascending order. Union labels form a
+   DAG, so every label is walked at most once. */
+
+static void expand(FILE* f, dfsan_label l) {
+
+  static u8 hit[TAINT_MAX_OFFSETS];
+  u32 top = 0, i;
+
+  memset(visited, 0, sizeof(visited));
+  memset(hit, 0, sizeof(hit));
+
+  stack[top++] = l;
+  visited[l >> 3] |= 1 << (l & 7);
+
+  while (top) {
+
+    dfsan_label cur = stack[--top];
+    const struct dfsan_label_info* info;
+    dfsan_label next[2];
+
+    if (label_off[cur]) {
+      hit[label_off[cur] - 1] = 1;
+      continue;
+    }
+
+    info = dfsan_get_label_info(cur);
+    next[0] = info->l1;
+    next[1] = info->l2;
+
+    for (i = 0; i < 2; i++) {
+
+      if (!next[i] || (visited[next[i] >> 3] & (1 << (next[i] & 7))))
+        continue;
+
+      visited[next[i] >> 3] |= 1 << (next[i] & 7);
+      stack[top++] = next[i];
+
+    }
+
+  }
+
+  for (i = 0; i < TAINT_MAX_OFFSETS; i++)
+    if (hit[i]) fprintf(f, " %u", i);
+
+}
+
+
+static void __taint_write_map(void) {
+
+  u8* out = getenv("AFL_TAINT_OUT");
+  FILE* f = fopen(out ? (char*)out : "taint_map", "w");
+  u32 i;
+
+  if (!f) return;
+
+  for (i = 0; i < MAP_SIZE; i++) {
+
+    if (!br_label[i]) continue;
+
+    fprintf(f, "%u:", i);
+    expand(f, br_label[i]);
+    fprintf(f, "\n");
+
+  }
+
+  fclose(f);
+
+}
+
+
+__attribute__((constructor)) void __taint_init(void) {
+
+  u8* in = getenv("AFL_TAINT_INPUT");
+  struct stat st;
+
+  if (in && !stat((char*)in, &st)) {
+    input_dev = st.st_dev;
+    input_ino = st.st_ino;
+    input_set = 1;
+  }
+
+  atexit(__taint_write_map);
+
+}
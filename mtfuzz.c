@@ -22,6 +22,9 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <time.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <limits.h>
 
 /* Most of code is borrowed directly from AFL fuzzer (https://github.com/mirrorer/afl), credits to Michal Zalewski */
 
@@ -39,6 +42,13 @@
 #define EXEC_FAIL_SIG       0xfee1dead
 /* Smoothing divisor for CPU load and exec speed stats (1 - no smoothing). */
 #define AVG_SMOOTHING       16
+/* Retrain scheduler: never retrain before RETRAIN_MIN_LINES gradient lines, always retrain after RETRAIN_MAX_LINES. */
+#define RETRAIN_MIN_LINES   20
+#define RETRAIN_MAX_LINES   400
+/* Number of recent gradient lines used to estimate the current new edge rate. */
+#define PLATEAU_WINDOW      10
+/* Retrain when the recent new edge rate drops below this fraction of the round's rate. */
+#define PLATEAU_RATIO       0.25
 /* Caps on block sizes for inserion and deletion operations. The set of numbers are adaptive to file length and the defalut max file length is 10000. */
 /* default setting, will be changed later accroding to file len */
 int havoc_blk_small = 2048;
@@ -50,6 +60,15 @@ int havoc_blk_large = 8192;
  
 #define MEM_BARRIER() \
     asm volatile("" ::: "memory")
+/* Size of the mutation buffers (out_buf3 is twice as large). */
+#define MUT_BUF_SIZE        10000
+#define LANE_MUT_CNT_BASE   10000000    /* First mut_cnt of lane k is k * base        */
+#define SOLVE_MAX_EXECS     256         /* Exec budget of the operand distance solver */
+#define SOLVE_MAX_HOT       64          /* Hot bytes the solver probes                */
+#define LOC_MAX             10000       /* Critical bytes of one gradient line        */
+#define MAGIC_MAX_EXECS     4096        /* Exec budget of the magic insertion stage   */
+#define MAGIC_ENC_NUM       5           /* Encodings tried by the magic insertion stage */
+#define BR_TARGET_EXIT      92          /* Exit status of a child stopped at AFL_BR_TARGET, as in br_pass config.h */
 /* Map size for the traced binary. */
 #define MAP_SIZE            2<<18
  
@@ -126,13 +145,37 @@ char virgin_bits[MAP_SIZE];             /* Regions yet untouched by fuzzing */
 static int mut_cnt = 0;                 /* Total mutation counter           */
 char *out_buf, *out_buf1, *out_buf2, *out_buf3;
 size_t len;                             /* Maximum file length for every mutation */
-int loc[10000];                         /* Array to store critical bytes locations*/
-int sign[10000];                        /* Array to store sign of critical bytes  */
+unsigned long sched_execs[PLATEAU_WINDOW]; /* total_execs at the start of recent gradient lines */
+int sched_edges[PLATEAU_WINDOW];        /* Edge coverage at the start of recent gradient lines */
+int target_edge = -1;                   /* Raw edge id targeted by the current gradient line */
+int target_base = 0;                    /* Whether the unmutated seed hits target_edge */
+int target_flip = 0;                    /* Whether any mutation changed target_edge */
+int target_br_id = -1;                  /* Compare solved by the operand solver, -1 when fuzzing */
+int target_br_type = 0;                 /* br_type of target_br_id                 */
+int solve_want = 0;                     /* Outcome the solver drives the compare to */
+char* hot_file = NULL;                  /* Hot byte offsets for the solver          */
+char* magic_str = NULL;                 /* Magic constant inserted by magic_br (-M)  */
+u64 magic_val = 0;
+unsigned long target_stops = 0;         /* Execs that stopped right after the target compare */
+int ctx_target = 0;                     /* Fuzzing the ctx instrumented binary */
+int bootstrap = 0;                      /* Fuzzing with heuristic gradients while the first model trains */
+int provenance_mode = 0;                /* Log provenance records instead of saving inputs */
+int lane = 0;                           /* Lane of this instance, 0 is connected to the NN */
+int lane_num = 1;                       /* Lanes sharing one gradient file           */
+char *prov_parent,                      /* Seed mutated by the current gradient line */
+     *prov_grad;                        /* Archived copy of the current gradient file */
+u64 prov_hash;                          /* Hash of the current seed */
+int prov_line;                          /* Line of the current gradient in prov_grad */
+int loc[LOC_MAX];                       /* Array to store critical bytes locations*/
+int sign[LOC_MAX];                      /* Array to store sign of critical bytes  */
+int loc_num = 0;                        /* Entries of loc[] and sign[] of the current line */
 
 /* more fined grined mutation can have better results but slower*/
 //int num_index[23] = {0,2,4,8,16,32,64,128,256,512,1024,1536,2048,2560,3072, 3584,4096,4608,5120, 5632,6144,6656,7103};
 /* default setting, will be change according to different file length */
 int num_index[14] = {0,2,4,8,16,32,64,128,256,512,1024,2048,4096,8192};
+/* sweeps kept by the NN pre-screen, up and low sweep of every bucket */
+char sweep_mask[26];
 
 enum {
   /* 00 */ FAULT_NONE,
@@ -143,6 +186,17 @@ enum {
   /* 05 */ FAULT_NOBITS
 };
 
+/* Provenance of the input under test: which gradient bucket and sweep step
+   produced it, and the insertion/deletion applied on top, if any. */
+struct provenance {
+  int iter;                             /* Bucket index, -1 for the seed itself */
+  int lo, hi;                           /* Bucket range in loc[]                */
+  int step;                             /* Sweep step                           */
+  int dir;                              /* 0 seed, 1 up sweep, 2 low sweep      */
+  int op;                               /* 0 none, 1 deletion, 2 insertion      */
+  int del_loc, cut_len, rand_loc;       /* Insertion/deletion parameters        */
+} cur_prov;
+
 /* Spin up fork server (instrumented mode only). The idea is explained here:
    http://lcamtuf.blogspot.com/2014/10/fuzzing-binaries-without-execve.html
    In essence, the instrumentation allows us to skip execve(), and just keep
@@ -150,7 +204,7 @@ enum {
    through a pipe. The other part of this logic is in afl-as.h. */
 void setup_stdio_file(void) {
 
-  char* fn = alloc_printf("%s/.cur_input", out_dir);
+  char* fn = lane ? alloc_printf("%s/.cur_input_%d", out_dir, lane) : alloc_printf("%s/.cur_input", out_dir);
 
   unlink(fn); /* Ignore errors */
 
@@ -576,7 +630,7 @@ void detect_file_args(char** argv) {
 
       if (!out_file)
         //out_file = "/dev/shm/dd/.cur_input";
-        out_file = alloc_printf("%s/.cur_input", out_dir);
+        out_file = lane ? alloc_printf("%s/.cur_input_%d", out_dir, lane) : alloc_printf("%s/.cur_input", out_dir);
 
       /* Be sure that we're always using fully-qualified paths. */
 
@@ -966,6 +1020,8 @@ static u8 run_target(int timeout) {
      territory. */
 
   memset(trace_bits, 0, MAP_SIZE);
+  /* the check_br* hooks read the compare to report from the first word */
+  if (target_br_id >= 0) ((int*)trace_bits)[0] = target_br_id;
   MEM_BARRIER();
 
     int res;
@@ -1017,6 +1073,9 @@ static u8 run_target(int timeout) {
 
   total_execs++;
 
+  /* a child built with br_pass stops right after AFL_BR_TARGET: a normal run */
+  if (WIFEXITED(status) && WEXITSTATUS(status) == BR_TARGET_EXIT) target_stops++;
+
   /* Any subsequent operations on trace_bits must not be moved by the
      compiler below this point. Past this location, trace_bits[] behave
      very normally and do not have to be treated as volatile. */
@@ -1024,11 +1083,17 @@ static u8 run_target(int timeout) {
   MEM_BARRIER();
 
 
+  /* operands reported by check_br* are not hit counts */
+  if (target_br_id < 0) {
 #ifdef __x86_64__
-  classify_counts((u64*)trace_bits);
+    classify_counts((u64*)trace_bits);
 #else
-  classify_counts((u32*)trace_bits);
+    classify_counts((u32*)trace_bits);
 #endif /* ^__x86_64__ */
+  }
+
+  if (target_edge >= 0 && (trace_bits[target_edge] != 0) != target_base)
+    target_flip = 1;
 
   prev_timed_out = child_timed_out;
 
@@ -1109,20 +1174,20 @@ static void check_cpu_governor(void) {
 
 }
 
-/* parse one line of gradient string into array */
-void parse_array(char * str, int * array){
+/* parse one line of gradient string into array, returns the number of entries */
+int parse_array(char * str, int * array){
     
     int i=0;
     
-    char* token = strtok(str,",");
+    char* token = str ? strtok(str,",") : NULL;
     
-    while(token != NULL){
+    while(token != NULL && i < LOC_MAX){
         array[i]=atoi(token);
         i++;
         token = strtok(NULL, ",");
     }
 
-    return;
+    return i;
 }
 
 /* Helper to choose random block len for block operations in fuzz_one().
@@ -1152,6 +1217,186 @@ static u32 choose_block_len(u32 limit) {
 
 }
 
+/* FNV-1a hash of a seed, used to check the parent of a provenance record */
+static u64 hash_buf(u8* buf, u32 size){
+    u64 h = 0xcbf29ce484222325ULL;
+    for(u32 i=0; i<size; i++){
+        h ^= buf[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* record how the next input is derived from the current seed */
+static inline void set_prov(int iter, int lo, int hi, int step, int dir, int op, int del_loc, int cut_len, int rand_loc){
+    cur_prov.iter = iter;
+    cur_prov.lo = lo;
+    cur_prov.hi = hi;
+    cur_prov.step = step;
+    cur_prov.dir = dir;
+    cur_prov.op = op;
+    cur_prov.del_loc = del_loc;
+    cur_prov.cut_len = cut_len;
+    cur_prov.rand_loc = rand_loc;
+}
+
+/* append a provenance record for mut_fn to .provenance in its directory. The log is
+   locked while writing, and reopened if materialize() renamed it in the meantime. */
+void log_provenance(char* mut_fn, u32 size){
+    char* name = strrchr(mut_fn, '/');
+    char* log_fn = alloc_printf("%.*s/.provenance", (int)(name - mut_fn), mut_fn);
+    struct stat st1, st2;
+    while(1){
+        int fd = open(log_fn, O_WRONLY | O_CREAT | O_APPEND, 0600);
+        if(fd == -1){
+            perror("open failed");
+            break;
+        }
+        flock(fd, LOCK_EX);
+        if(fstat(fd, &st1) == 0 && stat(log_fn, &st2) == 0 && st1.st_ino == st2.st_ino){
+            dprintf(fd, "%s %s %016llx %s %d %d %d %d %d %d %d %d %d %d %d %u\n", name + 1, prov_parent,
+                    (unsigned long long)prov_hash, prov_grad, prov_line, (int)len, cur_prov.iter, cur_prov.lo, cur_prov.hi,
+                    cur_prov.step, cur_prov.dir, cur_prov.op, cur_prov.del_loc, cur_prov.cut_len, cur_prov.rand_loc, size);
+            close(fd);
+            break;
+        }
+        close(fd);
+    }
+    free(log_fn);
+}
+
+/* save an interesting input, or only its provenance record in provenance mode. Takes ownership of mut_fn. */
+void save_input(char* mut_fn, char* buf, u32 size){
+    if(provenance_mode && prov_parent){
+        log_provenance(mut_fn, size);
+    }
+    else{
+        int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
+        ck_write(mut_fd, buf, size, mut_fn);
+        close(mut_fd);
+    }
+    free(mut_fn);
+    mut_cnt = mut_cnt + 1;
+}
+
+/* rebuild the inputs logged in dir/.provenance */
+void materialize(char* dir){
+    char* log_fn = alloc_printf("%s/.provenance", dir);
+    char* tmp_fn = alloc_printf("%s/.provenance.%d", dir, getpid());
+    if(rename(log_fn, tmp_fn) == -1){
+        free(log_fn);
+        free(tmp_fn);
+        return;
+    }
+    int log_fd = open(tmp_fn, O_RDONLY);
+    if(log_fd == -1){
+        perror("open failed");
+        exit(0);
+    }
+    /* wait for writers that still hold the old log */
+    flock(log_fd, LOCK_EX);
+    FILE* stream = fdopen(log_fd, "r");
+    char *line = NULL, *grad_line = NULL;
+    size_t llen = 0, glen = 0;
+    char name[256], parent[512], grad[256], cached_grad[256] = "";
+    unsigned long long hash;
+    int line_no, cached_line = -1, rlen, iter, lo, hi, step, sweep_dir, op, del_loc, cut_len, rand_loc;
+    u32 size;
+    char* base = malloc(MUT_BUF_SIZE);
+    char* out = malloc(2 * MUT_BUF_SIZE);
+    int done = 0, failed = 0;
+
+    while(getline(&line, &llen, stream) != -1){
+        if(sscanf(line, "%255s %511s %llx %255s %d %d %d %d %d %d %d %d %d %d %d %u", name, parent, &hash, grad, &line_no,
+                  &rlen, &iter, &lo, &hi, &step, &sweep_dir, &op, &del_loc, &cut_len, &rand_loc, &size) != 16)
+            continue;
+        char* mut_fn = alloc_printf("%s/%s", dir, name);
+        if(access(mut_fn, F_OK) == 0){
+            free(mut_fn);
+            continue;
+        }
+
+        /* parent seed, padded with zeros like out_buf in fuzz_lop() */
+        memset(base, 0, MUT_BUF_SIZE);
+        int fd = open(parent, O_RDONLY);
+        int plen = fd == -1 ? -1 : read(fd, base, MUT_BUF_SIZE);
+        if(fd != -1)
+            close(fd);
+
+        /* gradient line that drove the mutation */
+        if(plen >= 0 && (strcmp(grad, cached_grad) || line_no != cached_line)){
+            FILE* gf = fopen(grad, "r");
+            cached_line = -1;
+            for(int i=1; gf && getline(&grad_line, &glen, gf) != -1; i++){
+                if(i == line_no){
+                    char* loc_str = strtok(grad_line, "|");
+                    char* sign_str = strtok(NULL, "|");
+                    /* entries past the line are stale, the sweeps stop at loc_num */
+                    loc_num = parse_array(loc_str, loc);
+                    loc_num = MIN(loc_num, parse_array(sign_str, sign));
+                    strcpy(cached_grad, grad);
+                    cached_line = line_no;
+                    break;
+                }
+            }
+            if(gf)
+                fclose(gf);
+        }
+        if(plen < 0 || hash_buf((u8*)base, plen) != hash || cached_line != line_no || rlen + cut_len > 2 * MUT_BUF_SIZE || rand_loc + cut_len > MUT_BUF_SIZE){
+            fprintf(stderr, "cannot materialize %s\n", mut_fn);
+            char* fail_fn = alloc_printf("%s/.provenance.failed", dir);
+            FILE* ff = fopen(fail_fn, "a");
+            if(ff){
+                fputs(line, ff);
+                fclose(ff);
+            }
+            free(fail_fn);
+            free(mut_fn);
+            failed++;
+            continue;
+        }
+
+        /* replay the sweep up to the logged step */
+        for(int i=0; sweep_dir && i<=step; i++){
+            for(int index=lo; index<MIN(hi, loc_num); index++){
+                int mut_val = (u8)base[loc[index]] + (sweep_dir == 1 ? sign[index] : -sign[index]);
+                base[loc[index]] = mut_val < 0 ? 0 : (mut_val > 255 ? 255 : mut_val);
+            }
+        }
+
+        /* then the insertion or deletion, exactly as gen_mutate() builds out_buf3 */
+        u32 out_len = rlen;
+        memcpy(out, base, rlen);
+        if(op == 1){
+            memcpy(out+del_loc, base+del_loc+cut_len, rlen-del_loc-cut_len);
+            out_len = rlen - cut_len;
+        }
+        else if(op == 2){
+            memcpy(out+del_loc, base+rand_loc, cut_len);
+            memcpy(out+del_loc+cut_len, base+del_loc, rlen-del_loc);
+            out_len = rlen + cut_len;
+        }
+        if(out_len != size)
+            fprintf(stderr, "size mismatch for %s: %u vs %u\n", mut_fn, out_len, size);
+
+        int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
+        ck_write(mut_fd, out, out_len, mut_fn);
+        close(mut_fd);
+        free(mut_fn);
+        done++;
+    }
+    printf("materialized %d inputs in %s, %d failed\n", done, dir, failed);
+
+    free(line);
+    free(grad_line);
+    free(base);
+    free(out);
+    fclose(stream);
+    unlink(tmp_fn);
+    free(log_fn);
+    free(tmp_fn);
+}
+
 /* gradient guided mutation */
 void gen_mutate(){
     int tmout_cnt = 0;
@@ -1159,12 +1404,12 @@ void gen_mutate(){
     int has_new = 0;
     /* flip interesting locations within 14 iterations */
     for(int iter=0 ;iter<13; iter=iter+1){
-        memcpy(out_buf1, out_buf, len);        
-        memcpy(out_buf2, out_buf, len);        
+        memcpy(out_buf1, out_buf, MUT_BUF_SIZE);
+        memcpy(out_buf2, out_buf, MUT_BUF_SIZE);
         
         /* find mutation range for every iteration */
-        int low_index = num_index[iter];
-        int up_index = num_index[iter+1];
+        int low_index = MIN(num_index[iter], loc_num);
+        int up_index = MIN(num_index[iter+1], loc_num);
         u8 up_step = 0;
         u8 low_step = 0;
         for(int index=low_index; index<up_index; index=index+1){
@@ -1187,6 +1432,11 @@ void gen_mutate(){
                     low_step = cur_low_step;
             }
         }
+        /* skip sweeps the pre-screen predicts to be useless */
+        if(!sweep_mask[iter * 2])
+            up_step = 0;
+        if(!sweep_mask[iter * 2 + 1])
+            low_step = 0;
         
         /* up direction mutation(up to 255) */
         for(int step=0;step<up_step;step=step+1){
@@ -1201,39 +1451,25 @@ void gen_mutate(){
                     out_buf1[loc[index]] = mut_val;
             }
 
+            set_prov(iter, low_index, up_index, step, 1, 0, 0, 0, 0);
             write_to_testcase(out_buf1, len);    
             int fault = run_target(exec_tmout); 
             if (fault != 0){
                 if(fault == FAULT_CRASH){
-                    char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                    int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                    ck_write(mut_fd, out_buf1, len, mut_fn);
-                    free(mut_fn);
-                    close(mut_fd);
-                    mut_cnt = mut_cnt + 1;
+                    save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf1, len);
                 }
                 else if((fault = FAULT_TMOUT) && (tmout_cnt < 20)){
                     tmout_cnt = tmout_cnt + 1;
                     fault = run_target(1000); 
                     if(fault == FAULT_CRASH){
-                        char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                        int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                        ck_write(mut_fd, out_buf1, len, mut_fn);
-                        free(mut_fn);
-                        close(mut_fd);
-                        mut_cnt = mut_cnt + 1;
+                        save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf1, len);
                     } 
                 }
             }
             /* save mutations that find new edges. */
             int ret = has_new_bits(virgin_bits);
             if(ret == 2){
-                char* mut_fn = alloc_printf("%s/id_%d_%d_%06d_cov", out_dir, round_cnt, iter, mut_cnt);
-                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                ck_write(mut_fd, out_buf1, len, mut_fn);
-                free(mut_fn);
-                close(mut_fd);
-                mut_cnt = mut_cnt + 1;
+                save_input(alloc_printf("%s/id_%d_%d_%06d_cov", out_dir, round_cnt, iter, mut_cnt), out_buf1, len);
                 /* random inser/dele on the first new inputs */
                 if(has_new == 0){
                     has_new = 1;
@@ -1241,7 +1477,7 @@ void gen_mutate(){
                     int cut_len = 0;
                     int del_loc = 0;
                     int rand_loc = 0;
-                    for(int del_count=0; del_count < 1024;del_count= del_count+1){
+                    for(int del_count=0; del_count < MIN(1024, loc_num);del_count= del_count+1){
                         del_loc = loc[del_count];
                         if ((len- del_loc) <= 2)
                             continue;
@@ -1251,28 +1487,19 @@ void gen_mutate(){
                         memcpy(out_buf3, out_buf1,del_loc);
                         memcpy(out_buf3+del_loc, out_buf1+del_loc+cut_len, len-del_loc-cut_len);
 
+                        set_prov(iter, low_index, up_index, step, 1, 1, del_loc, cut_len, 0);
                         write_to_testcase(out_buf3, len-cut_len);
 
                         int fault = run_target(exec_tmout);
                         if (fault != 0){
                             if(fault == FAULT_CRASH){
-                                char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                                ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                                free(mut_fn);
-                                close(mut_fd);
-                                mut_cnt = mut_cnt + 1;
+                                save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len-cut_len);
                             }
                             else if((fault = FAULT_TMOUT) && (tmout_cnt < 20)){
                                 tmout_cnt = tmout_cnt + 1;
                                 fault = run_target(1000);
                                 if(fault == FAULT_CRASH){
-                                    char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                                    int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                                    ck_write(mut_fd, out_buf3, len - cut_len, mut_fn);
-                                    free(mut_fn);
-                                    close(mut_fd);
-                                    mut_cnt = mut_cnt + 1;
+                                    save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len - cut_len);
                                 }
                             }
                         }
@@ -1280,20 +1507,10 @@ void gen_mutate(){
                         /* save mutations that find new edges. */
                         int ret = has_new_bits(virgin_bits);
                         if(ret==2){
-                            char* mut_fn = alloc_printf("%s/id_%d_0_%06d_cov", out_dir,round_cnt, mut_cnt);
-                            int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                            ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                            free(mut_fn);
-                            close(mut_fd);
-                            mut_cnt = mut_cnt + 1;
+                            save_input(alloc_printf("%s/id_%d_0_%06d_cov", out_dir,round_cnt, mut_cnt), out_buf3, len-cut_len);
                         }
                         else if(ret==1){
-                            char* mut_fn = alloc_printf("%s/id_%d_0_%06d", out_dir,round_cnt, mut_cnt);
-                            int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                            ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                            free(mut_fn);
-                            close(mut_fd);
-                            mut_cnt = mut_cnt + 1;
+                            save_input(alloc_printf("%s/id_%d_0_%06d", out_dir,round_cnt, mut_cnt), out_buf3, len-cut_len);
                         }
 
                         cut_len = choose_block_len(len-1);
@@ -1304,28 +1521,19 @@ void gen_mutate(){
                         memcpy(out_buf3+del_loc, out_buf1+rand_loc, cut_len);
                         memcpy(out_buf3+del_loc+cut_len, out_buf1+del_loc, len-del_loc);
 
+                        set_prov(iter, low_index, up_index, step, 1, 2, del_loc, cut_len, rand_loc);
                         write_to_testcase(out_buf3, len+cut_len);
 
                         fault = run_target(exec_tmout);
                         if (fault != 0){
                             if(fault == FAULT_CRASH){
-                                char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                                ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                                free(mut_fn);
-                                close(mut_fd);
-                                mut_cnt = mut_cnt + 1;
+                                save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len+cut_len);
                             }
                             else if((fault = FAULT_TMOUT) && (tmout_cnt < 20)){
                                 tmout_cnt = tmout_cnt + 1;
                                 fault = run_target(1000);
                                 if(fault == FAULT_CRASH){
-                                    char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                                    int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                                    ck_write(mut_fd, out_buf3, len + cut_len, mut_fn);
-                                    free(mut_fn);
-                                    close(mut_fd);
-                                    mut_cnt = mut_cnt + 1;
+                                    save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len + cut_len);
                                 }
                             }
                         }
@@ -1333,32 +1541,17 @@ void gen_mutate(){
                         /* save mutations that find new edges. */
                         ret = has_new_bits(virgin_bits);
                         if(ret == 2){
-                            char* mut_fn = alloc_printf("%s/id_%d_0_%06d_cov", "vari_seeds",round_cnt, mut_cnt);
-                            int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                            ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                            free(mut_fn);
-                            close(mut_fd);
-                            mut_cnt = mut_cnt + 1;
+                            save_input(alloc_printf("%s/id_%d_0_%06d_cov", "vari_seeds",round_cnt, mut_cnt), out_buf3, len+cut_len);
                         }
                         else if(ret == 1){
-                            char* mut_fn = alloc_printf("%s/id_%d_0_%06d", "vari_seeds",round_cnt, mut_cnt);
-                            int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                            ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                            free(mut_fn);
-                            close(mut_fd);
-                            mut_cnt = mut_cnt + 1;
+                            save_input(alloc_printf("%s/id_%d_0_%06d", "vari_seeds",round_cnt, mut_cnt), out_buf3, len+cut_len);
                         }
                     }
 
                 }
             }
             if(ret == 1){
-                char* mut_fn = alloc_printf("%s/id_%d_%d_%06d", out_dir, round_cnt, iter, mut_cnt);
-                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                ck_write(mut_fd, out_buf1, len, mut_fn);
-                free(mut_fn);
-                close(mut_fd);
-                mut_cnt = mut_cnt + 1;
+                save_input(alloc_printf("%s/id_%d_%d_%06d", out_dir, round_cnt, iter, mut_cnt), out_buf1, len);
             }
             
         }
@@ -1375,27 +1568,18 @@ void gen_mutate(){
                     out_buf2[loc[index]] = mut_val;
             }
             
+            set_prov(iter, low_index, up_index, step, 2, 0, 0, 0, 0);
             write_to_testcase(out_buf2, len);    
             int fault = run_target(exec_tmout); 
             if (fault != 0){
                 if(fault == FAULT_CRASH){
-                    char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                    int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                    ck_write(mut_fd, out_buf2, len, mut_fn);
-                    free(mut_fn);
-                    close(mut_fd);
-                    mut_cnt = mut_cnt + 1;
+                    save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf2, len);
                 }
                 else if((fault = FAULT_TMOUT) && (tmout_cnt < 20)){
                     tmout_cnt = tmout_cnt + 1;
                     fault = run_target(1000); 
                     if(fault == FAULT_CRASH){
-                        char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                        int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                        ck_write(mut_fd, out_buf2, len, mut_fn);
-                        free(mut_fn);
-                        close(mut_fd);
-                        mut_cnt = mut_cnt + 1;
+                        save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf2, len);
                     } 
                 }
             }
@@ -1403,12 +1587,7 @@ void gen_mutate(){
             /* save mutations that find new edges. */
             int ret = has_new_bits(virgin_bits);
             if(ret == 2){
-                char* mut_fn = alloc_printf("%s/id_%d_%d_%06d_cov", out_dir, round_cnt, iter, mut_cnt);
-                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                ck_write(mut_fd, out_buf2, len, mut_fn);
-                close(mut_fd);
-                free(mut_fn);
-                mut_cnt = mut_cnt + 1;
+                save_input(alloc_printf("%s/id_%d_%d_%06d_cov", out_dir, round_cnt, iter, mut_cnt), out_buf2, len);
                 /* random inser/dele on the first new inputs */
                 if(has_new == 0){
                     has_new = 1;
@@ -1416,7 +1595,7 @@ void gen_mutate(){
                     int cut_len = 0;
                     int del_loc = 0;
                     int rand_loc = 0;
-                    for(int del_count=0; del_count < 1024;del_count= del_count+1){
+                    for(int del_count=0; del_count < MIN(1024, loc_num);del_count= del_count+1){
                         del_loc = loc[del_count];
                         if ((len- del_loc) <= 2)
                             continue;
@@ -1426,28 +1605,19 @@ void gen_mutate(){
                         memcpy(out_buf3, out_buf2, del_loc);
                         memcpy(out_buf3+del_loc, out_buf2+del_loc+cut_len, len-del_loc-cut_len);
 
+                        set_prov(iter, low_index, up_index, step, 2, 1, del_loc, cut_len, 0);
                         write_to_testcase(out_buf3, len-cut_len);
 
                         int fault = run_target(exec_tmout);
                         if (fault != 0){
                             if(fault == FAULT_CRASH){
-                                char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                                ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                                free(mut_fn);
-                                close(mut_fd);
-                                mut_cnt = mut_cnt + 1;
+                                save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len-cut_len);
                             }
                             else if((fault = FAULT_TMOUT) && (tmout_cnt < 20)){
                                 tmout_cnt = tmout_cnt + 1;
                                 fault = run_target(1000);
                                 if(fault == FAULT_CRASH){
-                                    char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                                    int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                                    ck_write(mut_fd, out_buf3, len - cut_len, mut_fn);
-                                    free(mut_fn);
-                                    close(mut_fd);
-                                    mut_cnt = mut_cnt + 1;
+                                    save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len - cut_len);
                                 }
                             }
                         }
@@ -1455,20 +1625,10 @@ void gen_mutate(){
                         /* save mutations that find new edges. */
                         int ret = has_new_bits(virgin_bits);
                         if(ret==2){
-                            char* mut_fn = alloc_printf("%s/id_%d_0_%06d_cov", out_dir,round_cnt, mut_cnt);
-                            int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                            ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                            free(mut_fn);
-                            close(mut_fd);
-                            mut_cnt = mut_cnt + 1;
+                            save_input(alloc_printf("%s/id_%d_0_%06d_cov", out_dir,round_cnt, mut_cnt), out_buf3, len-cut_len);
                         }
                         else if(ret==1){
-                            char* mut_fn = alloc_printf("%s/id_%d_0_%06d", out_dir,round_cnt, mut_cnt);
-                            int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                            ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                            free(mut_fn);
-                            close(mut_fd);
-                            mut_cnt = mut_cnt + 1;
+                            save_input(alloc_printf("%s/id_%d_0_%06d", out_dir,round_cnt, mut_cnt), out_buf3, len-cut_len);
                         }
 
                         cut_len = choose_block_len(len-1);
@@ -1479,28 +1639,19 @@ void gen_mutate(){
                         memcpy(out_buf3+del_loc, out_buf2+rand_loc, cut_len);
                         memcpy(out_buf3+del_loc+cut_len, out_buf2+del_loc, len-del_loc);
 
+                        set_prov(iter, low_index, up_index, step, 2, 2, del_loc, cut_len, rand_loc);
                         write_to_testcase(out_buf3, len+cut_len);
 
                         fault = run_target(exec_tmout);
                         if (fault != 0){
                             if(fault == FAULT_CRASH){
-                                char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                                ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                                free(mut_fn);
-                                close(mut_fd);
-                                mut_cnt = mut_cnt + 1;
+                                save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len+cut_len);
                             }
                             else if((fault = FAULT_TMOUT) && (tmout_cnt < 20)){
                                 tmout_cnt = tmout_cnt + 1;
                                 fault = run_target(1000);
                                 if(fault == FAULT_CRASH){
-                                    char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                                    int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                                    ck_write(mut_fd, out_buf3, len + cut_len, mut_fn);
-                                    free(mut_fn);
-                                    close(mut_fd);
-                                    mut_cnt = mut_cnt + 1;
+                                    save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len + cut_len);
                                 }
                             }
                         }
@@ -1508,32 +1659,17 @@ void gen_mutate(){
                         /* save mutations that find new edges. */
                         ret = has_new_bits(virgin_bits);
                         if(ret == 2){
-                            char* mut_fn = alloc_printf("%s/id_%d_0_%06d_cov", "vari_seeds",round_cnt, mut_cnt);
-                            int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                            ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                            free(mut_fn);
-                            close(mut_fd);
-                            mut_cnt = mut_cnt + 1;
+                            save_input(alloc_printf("%s/id_%d_0_%06d_cov", "vari_seeds",round_cnt, mut_cnt), out_buf3, len+cut_len);
                         }
                         else if(ret == 1){
-                            char* mut_fn = alloc_printf("%s/id_%d_0_%06d", "vari_seeds",round_cnt, mut_cnt);
-                            int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                            ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                            free(mut_fn);
-                            close(mut_fd);
-                            mut_cnt = mut_cnt + 1;
+                            save_input(alloc_printf("%s/id_%d_0_%06d", "vari_seeds",round_cnt, mut_cnt), out_buf3, len+cut_len);
                         }
                     }
 
                 }
             }
             if(ret == 1){
-                char* mut_fn = alloc_printf("%s/id_%d_%d_%06d", out_dir, round_cnt, iter, mut_cnt);
-                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                ck_write(mut_fd, out_buf2, len, mut_fn);
-                close(mut_fd);
-                free(mut_fn);
-                mut_cnt = mut_cnt + 1;
+                save_input(alloc_printf("%s/id_%d_%d_%06d", out_dir, round_cnt, iter, mut_cnt), out_buf2, len);
             }
             
         }
@@ -1546,7 +1682,7 @@ void gen_mutate(){
         int cut_len = 0;
         int del_loc = 0;
         int rand_loc = 0;
-        for(int del_count=0; del_count < 1024;del_count= del_count+1){
+        for(int del_count=0; del_count < MIN(1024, loc_num);del_count= del_count+1){
             del_loc = loc[del_count];
             if ((len- del_loc) <= 2)
                 continue;
@@ -1556,28 +1692,19 @@ void gen_mutate(){
             memcpy(out_buf3, out_buf,del_loc);
             memcpy(out_buf3+del_loc, out_buf+del_loc+cut_len, len-del_loc-cut_len);
 
+            set_prov(-1, 0, 0, -1, 0, 1, del_loc, cut_len, 0);
             write_to_testcase(out_buf3, len-cut_len);
 
             int fault = run_target(exec_tmout);
             if (fault != 0){
                 if(fault == FAULT_CRASH){
-                    char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                    int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                    ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                    free(mut_fn);
-                    close(mut_fd);
-                    mut_cnt = mut_cnt + 1;
+                    save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len-cut_len);
                 }
                 else if((fault = FAULT_TMOUT) && (tmout_cnt < 20)){
                     tmout_cnt = tmout_cnt + 1;
                     fault = run_target(1000);
                     if(fault == FAULT_CRASH){
-                        char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                        int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                        ck_write(mut_fd, out_buf3, len - cut_len, mut_fn);
-                        free(mut_fn);
-                        close(mut_fd);
-                        mut_cnt = mut_cnt + 1;
+                        save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len - cut_len);
                     }
                 }
             }
@@ -1585,20 +1712,10 @@ void gen_mutate(){
             /* save mutations that find new edges. */
             int ret = has_new_bits(virgin_bits);
             if(ret==2){
-                char* mut_fn = alloc_printf("%s/id_%d_0_%06d_cov", out_dir,round_cnt, mut_cnt);
-                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                free(mut_fn);
-                close(mut_fd);
-                mut_cnt = mut_cnt + 1;
+                save_input(alloc_printf("%s/id_%d_0_%06d_cov", out_dir,round_cnt, mut_cnt), out_buf3, len-cut_len);
             }
             else if(ret==1){
-                char* mut_fn = alloc_printf("%s/id_%d_0_%06d", out_dir,round_cnt, mut_cnt);
-                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                ck_write(mut_fd, out_buf3, len-cut_len, mut_fn);
-                free(mut_fn);
-                close(mut_fd);
-                mut_cnt = mut_cnt + 1;
+                save_input(alloc_printf("%s/id_%d_0_%06d", out_dir,round_cnt, mut_cnt), out_buf3, len-cut_len);
             }
 
             cut_len = choose_block_len(len-1);
@@ -1609,28 +1726,19 @@ void gen_mutate(){
             memcpy(out_buf3+del_loc, out_buf+rand_loc, cut_len);
             memcpy(out_buf3+del_loc+cut_len, out_buf+del_loc, len-del_loc);
 
+            set_prov(-1, 0, 0, -1, 0, 2, del_loc, cut_len, rand_loc);
             write_to_testcase(out_buf3, len+cut_len);
 
             fault = run_target(exec_tmout);
             if (fault != 0){
                 if(fault == FAULT_CRASH){
-                    char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                    int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                    ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                    free(mut_fn);
-                    close(mut_fd);
-                    mut_cnt = mut_cnt + 1;
+                    save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len+cut_len);
                 }
                 else if((fault = FAULT_TMOUT) && (tmout_cnt < 20)){
                     tmout_cnt = tmout_cnt + 1;
                     fault = run_target(1000);
                     if(fault == FAULT_CRASH){
-                        char* mut_fn = alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt);
-                        int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                        ck_write(mut_fd, out_buf3, len + cut_len, mut_fn);
-                        free(mut_fn);
-                        close(mut_fd);
-                        mut_cnt = mut_cnt + 1;
+                        save_input(alloc_printf("%s/crash_%d_%06d", "./crashes",round_cnt, mut_cnt), out_buf3, len + cut_len);
                     }
                 }
             }
@@ -1638,20 +1746,10 @@ void gen_mutate(){
             /* save mutations that find new edges. */
             ret = has_new_bits(virgin_bits);
             if(ret == 2){
-                char* mut_fn = alloc_printf("%s/id_%d_0_%06d_cov", "vari_seeds",round_cnt, mut_cnt);
-                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                free(mut_fn);
-                close(mut_fd);
-                mut_cnt = mut_cnt + 1;
+                save_input(alloc_printf("%s/id_%d_0_%06d_cov", "vari_seeds",round_cnt, mut_cnt), out_buf3, len+cut_len);
             }
             else if(ret == 1){
-                char* mut_fn = alloc_printf("%s/id_%d_0_%06d", "vari_seeds",round_cnt, mut_cnt);
-                int mut_fd = open(mut_fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-                ck_write(mut_fd, out_buf3, len+cut_len, mut_fn);
-                free(mut_fn);
-                close(mut_fd);
-                mut_cnt = mut_cnt + 1;
+                save_input(alloc_printf("%s/id_%d_0_%06d", "vari_seeds",round_cnt, mut_cnt), out_buf3, len+cut_len);
             }
         }
     }
@@ -1732,6 +1830,15 @@ void dry_run(char* dir, int stage){
         exec_tmout = (exec_tmout + 20) / 20 * 20;
         exec_tmout =  exec_tmout;
         printf("avg %d time out %d cnt %d sum %lld \n.",(int)avg_us, exec_tmout, cnt,total_cal_us);
+
+        /* let the NN module decide whether pre-screening sweeps pays off */
+        FILE* exec_fd = fopen("exec_us", "w");
+        if(exec_fd == NULL)
+            perror("open failed\n");
+        else{
+            fprintf(exec_fd, "%llu\n", avg_us);
+            fclose(exec_fd);
+        }
     }
 
     printf("avg %d time out\n.",exec_tmout);
@@ -1789,9 +1896,441 @@ void copy_seeds(char * in_dir, char * out_dir){
     return ;
 }
 
+/* check without blocking whether python module has sent us a message */
+int server_ready(int sock){
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    return poll(&pfd, 1, 0) > 0;
+}
+
+/* ask python module to retrain once the new edge rate of the last PLATEAU_WINDOW
+   gradient lines falls well below the rate of this round. At the usual retrain
+   interval, retrain only if the current gradients are no longer productive. */
+int should_retrain(int line_cnt, int retrain_interval, unsigned long round_execs, int round_edges){
+    int edges = count_non_255_bytes(virgin_bits);
+    int slot = line_cnt % PLATEAU_WINDOW;
+    int win_edges = edges - sched_edges[slot];
+    unsigned long win_execs = total_execs - sched_execs[slot];
+    sched_edges[slot] = edges;
+    sched_execs[slot] = total_execs;
+
+    if(line_cnt < RETRAIN_MIN_LINES)
+        return 0;
+    if(line_cnt >= RETRAIN_MAX_LINES)
+        return 1;
+
+    double round_rate = (double)(edges - round_edges) / MAX(total_execs - round_execs, 1);
+    double win_rate = (double)win_edges / MAX(win_execs, 1);
+    if(win_edges == 0 || win_rate < PLATEAU_RATIO * round_rate){
+        printf("new edge rate plateau at line %d: %.6f vs %.6f per exec\n", line_cnt, win_rate, round_rate);
+        return 1;
+    }
+    if(line_cnt >= retrain_interval && win_rate < round_rate)
+        return 1;
+    return 0;
+}
+
+/* notify python module to retrain */
+void send_train(int sock){
+    round_cnt++;
+    now = count_non_255_bytes(virgin_bits);
+    edge_gain = now - old;
+    old = now;
+    if(sock > 0)
+        send(sock,"train", 5,0);
+}
+
+/* Outcome of a compare with br_type type for operand distance d = op1 - op2,
+   taken with the signedness of the compare (see solve_exec). */
+static int br_taken(int type, long long d){
+    switch(type){
+        case 0: case 1: return d > 0;
+        case 3: case 4: return d >= 0;
+        case 5: case 6: return d < 0;
+        case 8: case 9: return d <= 0;
+        case 7: return d != 0;
+        default: return d == 0;
+    }
+}
+
+/* How far distance d is from giving outcome want, 0 once it does. */
+static long long br_cost(int type, long long d, int want){
+    if(br_taken(type, d) == want)
+        return 0;
+    switch(type){
+        /* boundary between d <= 0 and d > 0 */
+        case 0: case 1: case 8: case 9: return d > 0 ? d : 1 - d;
+        /* boundary between d < 0 and d >= 0 */
+        case 3: case 4: case 5: case 6: return d >= 0 ? d + 1 : -d;
+        /* equality: any change leaves d == 0, otherwise close the gap */
+        default: return d == 0 ? 1 : (d < 0 ? -d : d);
+    }
+}
+
+/* Unsigned compares: GT, GE, LT and LE of br_type 0, 3, 5 and 8. */
+static int br_unsigned(int type){
+    return type == 0 || type == 3 || type == 5 || type == 8;
+}
+
+/* Run buf and read the operands of target_br_id at the width the hook
+   reported them (1/2/4/8 bytes, 4 for strcmp). Returns 0 if the compare was
+   not reached. The distance is saturated so br_cost cannot overflow. */
+static int solve_exec(u8* buf, u32 size, long long* dist){
+    int* t = (int*)trace_bits;
+    write_to_testcase(buf, size);
+    run_target(exec_tmout);
+    if(t[3] != 12)
+        return 0;
+    int width = t[4] ? t[4] : 4;
+    u64 op1, op2, mag;
+    if(width == 8){
+        op1 = (u64)(u32)t[1] | ((u64)(u32)t[5] << 32);
+        op2 = (u64)(u32)t[2] | ((u64)(u32)t[6] << 32);
+    }else if(br_unsigned(target_br_type)){
+        u64 mask = (1ULL << (8 * width)) - 1;
+        op1 = (u64)(u32)t[1] & mask;
+        op2 = (u64)(u32)t[2] & mask;
+    }else{
+        /* the hooks sign extend narrower operands to int */
+        op1 = (u64)(long long)t[1];
+        op2 = (u64)(long long)t[2];
+    }
+    int gt = br_unsigned(target_br_type) ? op1 > op2 : (long long)op1 > (long long)op2;
+    mag = gt ? op1 - op2 : op2 - op1;
+    if(mag > LLONG_MAX - 1)
+        mag = LLONG_MAX - 1;
+    *dist = gt ? (long long)mag : -(long long)mag;
+    return 1;
+}
+
+/* Add delta to the width byte little endian word at off. */
+static void add_le(u8* buf, u32 size, u32 off, int width, long long delta){
+    u64 val = 0;
+    int i;
+    for(i = 0; i < width && off + i < size; i++)
+        val |= (u64)buf[off + i] << (8 * i);
+    val += (u64)delta;
+    for(i = 0; i < width && off + i < size; i++)
+        buf[off + i] = (val >> (8 * i)) & 0xff;
+}
+
+/* Read the seed of the -b stages into buf and the hot byte offsets of -H
+   into hot. Returns the seed size. */
+static u32 load_solve_seed(char* seed_fn, u8* buf, u32* hot, int* hot_num){
+    int fd = open(seed_fn, O_RDONLY);
+    if(fd == -1){
+        perror("open failed");
+        exit(0);
+    }
+    u32 size = read(fd, buf, MUT_BUF_SIZE);
+    close(fd);
+
+    *hot_num = 0;
+    FILE* hf = hot_file ? fopen(hot_file, "r") : NULL;
+    u32 off;
+    while(hf && *hot_num < SOLVE_MAX_HOT && fscanf(hf, "%u", &off) == 1){
+        if(off < size)
+            hot[(*hot_num)++] = off;
+    }
+    if(hf)
+        fclose(hf);
+    /* no hot bytes known: probe the head of the input */
+    if(*hot_num == 0){
+        for(off = 0; off < size && off < SOLVE_MAX_HOT; off++)
+            hot[(*hot_num)++] = off;
+    }
+    return size;
+}
+
+/* Drive target_br_id to its other outcome by descending the operand distance.
+   Each round measures the slope of the cost per hot byte with a +1 step, then
+   takes a Newton step on the steepest one, as a little endian word wide enough
+   for the step, halving it until the cost drops. Linear relations such as
+   x + c == y are solved by the first step. The solution goes to
+   out_dir/solved_<br_id>. */
+void solve_br(char* seed_fn){
+    u8* buf = malloc(MUT_BUF_SIZE);
+    u8* cand = malloc(MUT_BUF_SIZE);
+    u32 hot[SOLVE_MAX_HOT];
+    int hot_num;
+    long long dist, cost, c;
+    u32 size = load_solve_seed(seed_fn, buf, hot, &hot_num);
+
+    if(!solve_exec(buf, size, &dist)){
+        printf("###solve br %d not reached\n", target_br_id);
+        free(buf);
+        free(cand);
+        return;
+    }
+    solve_want = !br_taken(target_br_type, dist);
+    cost = br_cost(target_br_type, dist, solve_want);
+
+    long long slope[SOLVE_MAX_HOT];
+    while(cost > 0 && total_execs < SOLVE_MAX_EXECS){
+        for(int i = 0; i < hot_num && cost > 0; i++){
+            slope[i] = 0;
+            memcpy(cand, buf, size);
+            add_le(cand, size, hot[i], 1, 1);
+            if(!solve_exec(cand, size, &dist))
+                continue;
+            c = br_cost(target_br_type, dist, solve_want);
+            if(c == 0){
+                memcpy(buf, cand, size);
+                cost = 0;
+            }
+            slope[i] = c - cost;
+        }
+        if(cost == 0)
+            break;
+
+        /* steepest bytes first, fall back to flatter ones for the fine steps */
+        int improved = 0;
+        u8 tried[SOLVE_MAX_HOT] = { 0 };
+        while(!improved && total_execs < SOLVE_MAX_EXECS){
+            int best = -1;
+            for(int i = 0; i < hot_num; i++){
+                if(!tried[i] && slope[i] != 0 && (best < 0 || llabs(slope[i]) > llabs(slope[best])))
+                    best = i;
+            }
+            if(best < 0)
+                break;
+            tried[best] = 1;
+
+            long long step = -cost / slope[best];
+            if(step == 0)
+                step = slope[best] > 0 ? -1 : 1;
+            while(step != 0 && total_execs < SOLVE_MAX_EXECS){
+                long long mag = llabs(step);
+                int width = mag < 0x80 ? 1 : (mag < 0x8000 ? 2 : (mag < 0x80000000LL ? 4 : 8));
+                memcpy(cand, buf, size);
+                add_le(cand, size, hot[best], width, step);
+                if(solve_exec(cand, size, &dist) && (c = br_cost(target_br_type, dist, solve_want)) < cost){
+                    memcpy(buf, cand, size);
+                    cost = c;
+                    improved = 1;
+                    break;
+                }
+                step /= 2;
+            }
+        }
+        if(!improved)
+            break;
+    }
+
+    if(cost == 0){
+        char* fn = alloc_printf("%s/solved_%d", out_dir, target_br_id);
+        int out = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        ck_write(out, buf, size, fn);
+        close(out);
+        free(fn);
+        printf("###solved br %d in %lu execs, %lu stopped at the compare\n", target_br_id, total_execs, target_stops);
+    }
+    else
+        printf("###solve br %d failed, cost %lld after %lu execs, %lu stopped at the compare\n", target_br_id, cost, total_execs, target_stops);
+    free(buf);
+    free(cand);
+}
+
+/* Encodings of a magic constant tried by magic_br. */
+static const char* magic_enc_name[MAGIC_ENC_NUM] = { "le", "be", "dec", "hex", "varint" };
+
+/* Read the successes of each encoding on this target from magic_stats. */
+static void load_magic_stats(int* cnt){
+    char name[16];
+    int n;
+    memset(cnt, 0, sizeof(int) * MAGIC_ENC_NUM);
+    FILE* f = fopen("magic_stats", "r");
+    if(!f)
+        return;
+    while(fscanf(f, "%15s %d", name, &n) == 2){
+        for(int e = 0; e < MAGIC_ENC_NUM; e++){
+            if(!strcmp(name, magic_enc_name[e]))
+                cnt[e] = n;
+        }
+    }
+    fclose(f);
+}
+
+/* Count a success of encoding enc; crack workers share the file. */
+static void add_magic_stat(int enc){
+    int cnt[MAGIC_ENC_NUM];
+    int fd = open("magic_stats", O_RDWR | O_CREAT, 0600);
+    if(fd < 0)
+        return;
+    flock(fd, LOCK_EX);
+    load_magic_stats(cnt);
+    cnt[enc]++;
+    FILE* f = fdopen(fd, "w");
+    ftruncate(fd, 0);
+    for(int e = 0; e < MAGIC_ENC_NUM; e++)
+        fprintf(f, "%s %d\n", magic_enc_name[e], cnt[e]);
+    fflush(f);
+    flock(fd, LOCK_UN);
+    fclose(f);
+}
+
+/* Encode val as encoding enc into out, width bytes for the binary encodings
+   (upper selects upper case hex). Returns the length, 0 if val does not fit. */
+static int encode_magic(int enc, int width, u64 val, int upper, u8* out){
+    int len = 0;
+    char tmp[24];
+    switch(enc){
+        case 0: case 1:
+            if(width < 8 && (val >> (8 * width)))
+                return 0;
+            for(int i = 0; i < width; i++)
+                out[enc ? width - 1 - i : i] = (val >> (8 * i)) & 0xff;
+            return width;
+        case 2:
+            len = sprintf(tmp, "%llu", (unsigned long long)val);
+            break;
+        case 3:
+            len = sprintf(tmp, upper ? "%llX" : "%llx", (unsigned long long)val);
+            break;
+        default:
+            do{
+                out[len++] = (val & 0x7f) | (val > 0x7f ? 0x80 : 0);
+                val >>= 7;
+            }while(val);
+            return len;
+    }
+    memcpy(out, tmp, len);
+    return len;
+}
+
+/* Insert the magic constant of target_br_id (-M) at the hot bytes in every
+   plausible encoding: little/big endian words, ASCII decimal and hex, and
+   varint, each as is and +-1 for the strict compares. Encodings that worked
+   more often on this target (magic_stats) go first. The input that flips the
+   compare goes to out_dir/solved_<br_id>, like solve_br. */
+void magic_br(char* seed_fn){
+    u8* buf = malloc(MUT_BUF_SIZE);
+    u8* cand = malloc(MUT_BUF_SIZE);
+    u32 hot[SOLVE_MAX_HOT];
+    int hot_num, order[MAGIC_ENC_NUM], cnt[MAGIC_ENC_NUM];
+    long long dist;
+    u8 enc_buf[24];
+    static const long long deltas[] = { 0, 1, -1 };
+    /* GT and LT (br_type 0/1/5/6) miss the magic itself by one */
+    int t = target_br_type;
+    int delta_num = (t == 0 || t == 1 || t == 5 || t == 6) ? 3 : 1;
+    u32 size = load_solve_seed(seed_fn, buf, hot, &hot_num);
+
+    if(!solve_exec(buf, size, &dist)){
+        printf("###magic br %d not reached\n", target_br_id);
+        free(buf);
+        free(cand);
+        return;
+    }
+    solve_want = !br_taken(target_br_type, dist);
+
+    /* encodings by past successes, stable for ties */
+    load_magic_stats(cnt);
+    for(int e = 0; e < MAGIC_ENC_NUM; e++){
+        int j = e;
+        while(j > 0 && cnt[order[j - 1]] < cnt[e]){
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = e;
+    }
+
+    int found = -1;
+    long long found_delta = 0;
+    for(int o = 0; o < MAGIC_ENC_NUM && found < 0; o++){
+        int enc = order[o];
+        /* words in 4 widths, lower and upper case hex, one form otherwise */
+        int forms = enc < 2 ? 4 : (enc == 3 ? 2 : 1);
+        for(int d = 0; d < delta_num && found < 0; d++){
+            u64 val = magic_val + deltas[d];
+            for(int h = 0; h < hot_num && found < 0; h++){
+                for(int f = 0; f < forms && found < 0; f++){
+                    int len = encode_magic(enc, 1 << f, val, f, enc_buf);
+                    if(len == 0)
+                        continue;
+                    /* a word may start or end at the hot byte */
+                    for(int end = 0; end < (enc < 2 && len > 1 ? 2 : 1) && found < 0; end++){
+                        if(total_execs >= MAGIC_MAX_EXECS)
+                            goto done;
+                        if(end && hot[h] + 1 < (u32)len)
+                            continue;
+                        u32 at = end ? hot[h] + 1 - len : hot[h];
+                        if(at + len > size)
+                            continue;
+                        memcpy(cand, buf, size);
+                        memcpy(cand + at, enc_buf, len);
+                        if(solve_exec(cand, size, &dist) && br_taken(target_br_type, dist) == solve_want){
+                            found = enc;
+                            found_delta = deltas[d];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+done:
+    if(found >= 0){
+        char* fn = alloc_printf("%s/solved_%d", out_dir, target_br_id);
+        int out = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        ck_write(out, cand, size, fn);
+        close(out);
+        free(fn);
+        add_magic_stat(found);
+        printf("###magic br %d solved by %s%+lld in %lu execs\n", target_br_id, magic_enc_name[found], found_delta, total_execs);
+    }
+    else
+        printf("###magic br %d failed after %lu execs\n", target_br_id, total_execs);
+    free(buf);
+    free(cand);
+}
+
+/* every lane numbers its inputs from its own counter file, so names never collide */
+char* mut_cnt_file(void){
+    return lane ? alloc_printf("mut_cnt_%d", lane) : alloc_printf("mut_cnt");
+}
+
+void load_mut_cnt(void){
+    char* fn = mut_cnt_file();
+    FILE * fd = fopen(fn, "r");
+    if(fd == NULL){
+        if(lane){
+            mut_cnt = lane * LANE_MUT_CNT_BASE;
+            free(fn);
+            return;
+        }
+        perror("open failed\n");
+        exit(0);
+    }
+    fscanf (fd, "%d", &mut_cnt);
+    fclose(fd);
+    free(fn);
+}
+
+void store_mut_cnt(void){
+    char* fn = mut_cnt_file();
+    FILE* fd1 = fopen(fn, "w");
+    if(fd1 == NULL){
+        perror("open failed\n");
+        exit(0);
+    }
+    int ret= fprintf(fd1, "%d", mut_cnt);
+    if(ret == -1)
+        perror("fprintf error\n");
+    fclose(fd1);
+    free(fn);
+}
+
 /* parse the gradient to guide fuzzing */
 void fuzz_lop(char * grad_file, int sock){
     copy_file("gradient_info_p", grad_file);
+    /* provenance records refer to lines of an archived copy of the gradient file */
+    if(provenance_mode){
+        mkdir("provenance", 0700);
+        prov_grad = alloc_printf("provenance/gradient_%d", mut_cnt);
+        copy_file(grad_file, prov_grad);
+    }
     FILE *stream = fopen(grad_file, "r");
     char *line = NULL;
     size_t llen = 0;
@@ -1803,25 +2342,60 @@ void fuzz_lop(char * grad_file, int sock){
     int line_cnt=0;
     
     int retrain_interval = 100;
+    /* in bootstrap mode the model is already training */
+    int train_sent = bootstrap;
+    int replay = 0;
+    int grad_line = 0;
+    unsigned long round_execs = total_execs;
+    int round_edges = count_non_255_bytes(virgin_bits);
     
-    while ((nread = getline(&line, &llen, stream)) != -1) {        
+    while (1) {
+        nread = getline(&line, &llen, stream);
+        if(nread == -1){
+            if(!train_sent){
+                send_train(sock);
+                train_sent = 1;
+            }
+            if(sock <= 0 || line_cnt == 0 || server_ready(sock))
+                break;
+            /* model is still training, keep fuzzing with current gradients instead of waiting */
+            printf("model not ready, replay gradient file\n");
+            rewind(stream);
+            grad_line = 0;
+            replay = 1;
+            continue;
+        }
+        if((replay || bootstrap) && server_ready(sock))
+            break;
+        grad_line = grad_line+1;
+        /* lanes split the gradient file line by line */
+        if(lane_num > 1 && (grad_line - 1) % lane_num != lane)
+            continue;
         line_cnt = line_cnt+1;
         
         /* send message to python module */
-        if(line_cnt == retrain_interval){
-            round_cnt++;
-            now = count_non_255_bytes(virgin_bits);
-            edge_gain = now - old;
-            old = now;
-            send(sock,"train", 5,0);
+        if(!train_sent && should_retrain(line_cnt, retrain_interval, round_execs, round_edges)){
+            send_train(sock);
+            train_sent = 1;
         }
          
         /* parse gradient info */
         char* loc_str = strtok(line,"|");
         char* sign_str = strtok(NULL,"|");
-        char* fn = strtok(strtok(NULL,"|"),"\n"); 
-        parse_array(loc_str,loc);
-        parse_array(sign_str,sign);
+        char* fn = strtok(NULL,"|\n");
+        char* col_str = strtok(NULL,"|\n");
+        char* edge_str = strtok(NULL,"|\n");
+        char* kind_str = strtok(NULL,"|\n");
+        char* mask_str = strtok(NULL,"|\n");
+        char* pred_str = strtok(NULL,"|\n");
+        /* entries past the line are stale, the sweeps stop at loc_num */
+        loc_num = parse_array(loc_str,loc);
+        loc_num = MIN(loc_num, parse_array(sign_str,sign));
+        memset(sweep_mask, 1, sizeof(sweep_mask));
+        if(mask_str && strlen(mask_str) == sizeof(sweep_mask)){
+            for(int i = 0; i < sizeof(sweep_mask); i++)
+                sweep_mask[i] = (mask_str[i] == '1');
+        }
         
         /* print edge coverage per 10 files*/
         if((line_cnt % 10) == 0){ 
@@ -1851,16 +2425,51 @@ void fuzz_lop(char * grad_file, int sock){
         struct stat st;
         int ret = fstat(fn_fd,&st);
         int file_len = st.st_size;
-        memset(out_buf1,0,len);
-        memset(out_buf2,0,len);
-        memset(out_buf,0, len);
-        memset(out_buf3,0, 20000);
+        memset(out_buf1,0,MUT_BUF_SIZE);
+        memset(out_buf2,0,MUT_BUF_SIZE);
+        memset(out_buf,0, MUT_BUF_SIZE);
+        memset(out_buf3,0, 2 * MUT_BUF_SIZE);
         ck_read(fn_fd, out_buf, file_len, fn);
+        prov_parent = fn;
+        prov_hash = hash_buf((u8*)out_buf, file_len);
+        prov_line = grad_line;
         
+        /* check the target edge on the unmutated seed: ec and ctx edges are numbered
+           separately, so each binary only checks its own kind; approach level
+           edges (kind 2) are not tracked */
+        int edge = -1;
+        if(edge_str && kind_str && atoi(kind_str) == (ctx_target ? 1 : 0))
+            edge = atoi(edge_str);
+        unsigned long line_execs = total_execs;
+        int line_edges = count_non_255_bytes(virgin_bits);
+        if(edge >= 0 && edge < MAP_SIZE){
+            write_to_testcase(out_buf, len);
+            run_target(exec_tmout);
+            target_base = (trace_bits[edge] != 0);
+            target_flip = 0;
+            target_edge = edge;
+        }
+
         /* generate mutation */
         gen_mutate();
         close(fn_fd);
+
+        /* report whether the gradient flipped its target edge */
+        if(col_str){
+            FILE* eff = fopen("gradient_efficacy", "a");
+            if(eff == NULL){
+                perror("open failed\n");
+            }
+            else{
+                fprintf(eff, "%s %s %s %d %lu %d %s\n", col_str, edge_str ? edge_str : "-1", kind_str ? kind_str : "-1",
+                        target_edge >= 0 ? target_flip : -1, total_execs - line_execs, count_non_255_bytes(virgin_bits) - line_edges,
+                        pred_str ? pred_str : "-1");
+                fclose(eff);
+            }
+        }
+        target_edge = -1;
     }
+    prov_parent = NULL;
 
     free(line);
     fclose(stream);
@@ -1890,16 +2499,16 @@ void start_fuzz(int f_len){
     }
     
     /* set up buffer */
-    out_buf = malloc(10000);
+    out_buf = malloc(MUT_BUF_SIZE);
     if(!out_buf)
         perror("malloc failed");
-    out_buf1 = malloc(10000);
+    out_buf1 = malloc(MUT_BUF_SIZE);
     if(!out_buf1)
         perror("malloc failed");
-    out_buf2 = malloc(10000);
+    out_buf2 = malloc(MUT_BUF_SIZE);
     if(!out_buf2)
         perror("malloc failed");
-    out_buf3 = malloc(20000);
+    out_buf3 = malloc(2 * MUT_BUF_SIZE);
     if(!out_buf3)
         perror("malloc failed");
     
@@ -1911,18 +2520,18 @@ void start_fuzz(int f_len){
         // receive start message from server
         if(read(sock , buf, 5)== -1)
             perror("received failed\n");
+        /* "boots" means the first model is still training, fuzz with heuristic gradients until it is ready */
+        bootstrap = !strncmp(buf, "boots", 5);
+        if(bootstrap)
+            printf("#########bootstrap fuzzing\n");
         
+        /* provenance records are rebuilt by the NN module when it reads the
+           seeds (mtfuzz -R), dry runs only need the inputs it has rebuilt */
         /* dry run seeds*/
         dry_run(out_dir, 2);
         dry_run("./vari_seeds/", 0); 
         // load mut_cnt from disk
-        FILE * fd = fopen("mut_cnt", "r");
-        if(fd == NULL){
-            perror("open failed\n");
-            exit(0);
-        }
-        fscanf (fd, "%d", &mut_cnt);
-        fclose(fd);
+        load_mut_cnt();
         printf("#########start fuzzing %d\n", mut_cnt);
         
         // fuzzing
@@ -1936,15 +2545,7 @@ void start_fuzz(int f_len){
         printf("close connection\n");
         
         //write mut_cnt to disk
-        FILE* fd1 = fopen("mut_cnt", "w");
-        if(fd1 == NULL){
-            perror("open failed\n");
-            exit(0);
-        }
-        int ret= fprintf(fd1, "%d", mut_cnt);
-        if(ret == -1)
-            perror("fprintf error\n");
-        fclose(fd1);
+        store_mut_cnt();
 
     //}
     return;
@@ -1955,16 +2556,16 @@ void start_fuzz_test(int f_len){
     int sock = 0;
     
     /* set up buffer */
-    out_buf = malloc(10000);
+    out_buf = malloc(MUT_BUF_SIZE);
     if(!out_buf)
         perror("malloc failed");
-    out_buf1 = malloc(10000);
+    out_buf1 = malloc(MUT_BUF_SIZE);
     if(!out_buf1)
         perror("malloc failed");
-    out_buf2 = malloc(10000);
+    out_buf2 = malloc(MUT_BUF_SIZE);
     if(!out_buf2)
         perror("malloc failed");
-    out_buf3 = malloc(20000);
+    out_buf3 = malloc(2 * MUT_BUF_SIZE);
     if(!out_buf3)
         perror("malloc failed");
     
@@ -1974,27 +2575,15 @@ void start_fuzz_test(int f_len){
         dry_run(out_dir, 2);
         dry_run("./vari_seeds/", 0); 
         // load mut_cnt from disk
-        FILE * fd = fopen("mut_cnt", "r");
-        if(fd == NULL){
-            perror("open failed\n");
-            exit(0);
-        }
-        fscanf (fd, "%d", &mut_cnt);
-        fclose(fd);
+        load_mut_cnt();
         printf("#########start fuzzing %d\n", mut_cnt);
         
         // fuzzing
-        fuzz_lop("gradient_info", sock);
+        char* grad_file = alloc_printf("gradient_info_%d", lane);
+        fuzz_lop(grad_file, sock);
+        free(grad_file);
         //write mut_cnt to disk
-        FILE* fd1 = fopen("mut_cnt", "w");
-        if(fd1 == NULL){
-            perror("open failed\n");
-            exit(0);
-        }
-        int ret= fprintf(fd1, "%d", mut_cnt);
-        if(ret == -1)
-            perror("fprintf error\n");
-        fclose(fd1);
+        store_mut_cnt();
     /* fuzz */
         //fuzz_lop("gradient_info", sock);
     return;
@@ -2003,7 +2592,7 @@ void start_fuzz_test(int f_len){
 
 void main(int argc, char*argv[]){
     int opt;
-    while ((opt = getopt(argc, argv, "+i:o:l:")) > 0)
+    while ((opt = getopt(argc, argv, "+i:o:l:R:b:B:H:M:")) > 0)
 
     switch (opt) {
 
@@ -2040,10 +2629,36 @@ void main(int argc, char*argv[]){
          printf("mutation len: %ld\n", len);
          break;
       
+      case 'R': /* materialize provenance records of a directory and exit */
+        materialize(optarg);
+        exit(0);
+
+      case 'b': /* solve the compare of this branch id, -i is the seed file */
+        target_br_id = atoi(optarg);
+        break;
+
+      case 'B': /* br_type of the solved compare */
+        target_br_type = atoi(optarg);
+        break;
+
+      case 'H': /* hot byte offsets of the solved compare */
+        hot_file = optarg;
+        break;
+
+      case 'M': /* insert this magic constant instead of solving */
+        magic_str = optarg;
+        magic_val = strtoull(optarg, NULL, 10);
+        break;
+
     default:
         printf("no manual...");
     }
     
+    provenance_mode = (getenv("MTFUZZ_PROVENANCE") != NULL);
+    if(getenv("MTFUZZ_LANE"))
+        lane = atoi(getenv("MTFUZZ_LANE"));
+    if(getenv("MTFUZZ_LANES"))
+        lane_num = atoi(getenv("MTFUZZ_LANES"));
     setup_signal_handlers();
     check_cpu_governor();
     get_core_count();
@@ -2054,11 +2669,28 @@ void main(int argc, char*argv[]){
     if (!out_file) setup_stdio_file();
     detect_file_args(argv + optind + 1);
     setup_targetpath(argv[optind]);
+    ctx_target = (strlen(argv[optind]) > 4 && !strcmp(argv[optind] + strlen(argv[optind]) - 4, "_ctx"));
     
+    if (target_br_id >= 0){
+        /* let the target exit as soon as the compare has been reported */
+        char br_target[16];
+        sprintf(br_target, "%d", target_br_id);
+        setenv("AFL_BR_TARGET", br_target, 1);
+        init_forkserver(argv+optind);
+        if(magic_str)
+            magic_br(in_dir);
+        else
+            solve_br(in_dir);
+        exit(0);
+    }
     copy_seeds(in_dir, out_dir);
     init_forkserver(argv+optind);
    
-    start_fuzz(len);   
+    /* lanes other than 0 replay their share of the current gradient file offline */
+    if(lane)
+        start_fuzz_test(len);
+    else
+        start_fuzz(len);   
     printf("total execs %ld edge coverage %d.\n", total_execs, count_non_255_bytes(virgin_bits));
     return;
 }
@@ -10,8 +10,35 @@ import os
 import numpy as np
 import struct
 import time
+import re
+import multiprocessing
 FNULL = open(os.devnull, 'w')
 mut_cnt = 0
+# first mut_cnt of lane k without a counter file, same as LANE_MUT_CNT_BASE in mtfuzz
+LANE_MUT_CNT_BASE = 10000000
+# lane of the crack stage
+CRACK_LANE = 99
+# seconds between checks of the running stages
+POLL_SECS = 5
+# weight of the latest run in a stage's yield
+YIELD_DECAY = 0.5
+# scratch space of this crack worker, set by crack_worker_init
+tmp_train = 'tmp_train'
+tmp_non_direct = 'tmp_non_direct'
+tmp_input = 'tmp_input'
+tmp_solve = 'tmp_solve'
+tmp_taint = 'tmp_taint'
+tmp_found = 'tmp_found'
+# crack state shared with the workers
+resolved = {}
+missing = {}
+magic_dict = {}
+seeds = []
+crack_argvv = []
+# taint maps of the seeds, one taint run per seed and worker
+taint_maps = {}
+# inputs found by the current branch of this worker
+found = []
 '''
 def train(x, y):
     model = Sequential()
@@ -149,89 +176,261 @@ def find_unexplored_br(unexplored_1,unexplored_2, explored, seeds,tmp_argvv, arg
                 if f_len > tmp_len:
                     v[0] = ele
 
-# for each unexplored CMP-based branch, mutate hot bytes with intecepted operands
-# (TODO: clean this function, many duplicated code logic)
-def crack(tmp_argvv, argvv):
-    magic_dict = {}
+# check with afl-showbr that the solver's input solved takes the other outcome of
+# compare k than seed, like the crack loops below do; a crash is kept as such
+def solver_flipped(k, seed, solved, tmp_argvv, argvv):
+    target_env = dict(os.environ, AFL_BR_TARGET=str(k))
+    tmp_argvv[6] = argvv[6] + '_br'
+    hits = []
+    for f in [seed, solved]:
+        try:
+            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [f], env=target_env)
+        except subprocess.CalledProcessError:
+            if f == solved:
+                print("### found a crash " + str(k))
+                save_input(solved, 'crashes', k)
+            return False
+        hit = 0
+        for line in out.splitlines():
+            tokens = line.split(b':')
+            if int(tokens[0]) == k:
+                hit = int(tokens[1])
+        hits.append(hit)
+    return hits[0] != 0 and hits[1] != 0 and hits[0] != hits[1]
+
+# drive the compare of branch k to its other outcome with the operand distance
+# solver of mtfuzz, starting from seed and perturbing the hot bytes
+def solve_br(k, br_type, seed, hot_offsets, tmp_argvv, argvv):
+    if os.path.isdir(tmp_solve) == False:
+        os.makedirs(tmp_solve)
+    with open(tmp_solve + "/hot_offsets", 'w') as f:
+        f.write("\n".join([str(offset) for offset in hot_offsets]))
+    solved = tmp_solve + "/solved_" + str(k)
+    if os.path.exists(solved):
+        os.remove(solved)
+    tmp_argvv[6] = argvv[6] + '_br_fast'
+    env = dict(os.environ, AFL_NO_AFFINITY='1')
+    subprocess.run(['./mtfuzz', '-b', str(k), '-B', str(br_type), '-i', seed, '-o', tmp_solve, '-H', tmp_solve + '/hot_offsets'] + tmp_argvv[6:], stdout=FNULL, stderr=FNULL, env=env)
+    if not os.path.exists(solved) or not solver_flipped(k, seed, solved, tmp_argvv, argvv):
+        return False
+    print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc 0 solver")
+    save_input(solved, 'seeds', k)
+    return True
+
+# insert the magic constant of branch k at the hot bytes of seed in every
+# encoding (le/be words, ascii dec/hex, varint, +-1 for < and >) inside mtfuzz -b -M;
+# None when there is no _br_fast binary, so the python loop below takes over
+def magic_br(k, br_type, magic, seed, hot_offsets, tmp_argvv, argvv):
+    if not os.path.exists(argvv[6] + '_br_fast'):
+        return None
+    if os.path.isdir(tmp_solve) == False:
+        os.makedirs(tmp_solve)
+    with open(tmp_solve + "/hot_offsets", 'w') as f:
+        f.write("\n".join([str(offset) for offset in hot_offsets]))
+    solved = tmp_solve + "/solved_" + str(k)
+    if os.path.exists(solved):
+        os.remove(solved)
+    tmp_argvv[6] = argvv[6] + '_br_fast'
+    env = dict(os.environ, AFL_NO_AFFINITY='1')
+    subprocess.run(['./mtfuzz', '-b', str(k), '-B', str(br_type), '-M', str(magic), '-i', seed, '-o', tmp_solve, '-H', tmp_solve + '/hot_offsets'] + tmp_argvv[6:], stdout=FNULL, stderr=FNULL, env=env)
+    if not os.path.exists(solved) or not solver_flipped(k, seed, solved, tmp_argvv, argvv):
+        return False
+    print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " magic " + str(magic) + " encoded")
+    save_input(solved, 'seeds', k)
+    return True
+
+# run the taint flavour of the program on seed once and parse its taint_map:
+# br_id -> input offsets that flow into the operands of that compare
+def taint_map(seed, tmp_argvv, argvv):
+    if os.path.isdir(tmp_taint) == False:
+        os.makedirs(tmp_taint)
+    out = tmp_taint + "/taint_map"
+    if os.path.exists(out):
+        os.remove(out)
+    env = dict(os.environ, AFL_TAINT_INPUT=seed, AFL_TAINT_OUT=out)
+    try:
+        subprocess.run([argvv[6] + '_taint'] + tmp_argvv[7:-1] + [seed], stdout=FNULL, stderr=FNULL, env=env, timeout=60)
+    except subprocess.TimeoutExpired:
+        return {}
+    taint = {}
+    if os.path.exists(out):
+        with open(out, 'r') as f:
+            for line in f.read().splitlines():
+                tokens = line.split(':')
+                taint[int(tokens[0])] = [int(offset) for offset in tokens[1].split()]
+    return taint
+
+# input offsets to probe for branch k: the tainted bytes of its operands when a
+# <program>_taint binary exists, otherwise (or when taint saw none) every byte
+def probe_offsets(k, seed, taint_maps, tmp_argvv, argvv):
+    size = os.stat(seed).st_size
+    if not os.path.exists(argvv[6] + '_taint'):
+        return range(size)
+    if seed not in taint_maps:
+        taint_maps[seed] = taint_map(seed, tmp_argvv, argvv)
+    offsets = [offset for offset in taint_maps[seed].get(k, []) if offset < size]
+    if len(offsets) == 0:
+        return range(size)
+    return offsets
+
+# set up crack worker w: its scratch dirs and its view of the crack state
+def crack_worker_init(counter, resolved_, missing_, magic_dict_, seeds_, argvv):
+    global tmp_train, tmp_non_direct, tmp_input, tmp_solve, tmp_taint, tmp_found
+    global resolved, missing, magic_dict, seeds, crack_argvv
+    with counter.get_lock():
+        w = counter.value
+        counter.value = w + 1
+    tmp_train = 'tmp_train_' + str(w)
+    tmp_non_direct = 'tmp_non_direct_' + str(w)
+    tmp_input = 'tmp_input_' + str(w)
+    tmp_solve = 'tmp_solve_' + str(w)
+    tmp_taint = 'tmp_taint_' + str(w)
+    tmp_found = 'tmp_found_' + str(w)
+    for d in [tmp_train, tmp_non_direct, tmp_found]:
+        if os.path.isdir(d) == False:
+            os.makedirs(d)
+    resolved = resolved_
+    missing = missing_
+    magic_dict = magic_dict_
+    seeds = seeds_
+    crack_argvv = argvv
+
+def crack_worker(item):
+    global found
+    k, v = item
+    found = []
+    if k not in resolved:
+        crack_branch(k, v, crack_argvv.copy(), crack_argvv)
+    return found
+
+# keep an input found for branch k (kind is seeds or crashes) until the parent
+# moves it to the corpus; a new seed also cancels the branches it flips
+def save_input(src, kind, k):
+    global mut_cnt
+    dst = tmp_found + "/" + kind + "_" + str(k) + "_" + str(mut_cnt)
+    shutil.copyfile(src, dst)
+    mut_cnt = mut_cnt + 1
+    found.append((kind, k, dst))
+    if kind == 'seeds':
+        mark_resolved(dst)
+
+# mark the branches whose missing direction seed takes as resolved
+def mark_resolved(seed):
+    tmp_argvv = crack_argvv.copy()
+    tmp_argvv[6] = crack_argvv[6] + '_br'
+    try:
+        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
+    except subprocess.CalledProcessError:
+        return
+    for line in out.splitlines():
+        tokens = line.split(b':')
+        edge = int(tokens[0])
+        hit = int(tokens[1])
+        if edge in missing and (hit == 3 or hit == missing[edge]):
+            resolved[edge] = True
+
+# crack one unexplored branch k from its seeds v in this worker's scratch dirs;
+# the inputs it finds are collected by save_input
+def crack_branch(k, v, tmp_argvv, argvv):
     #possible_val = [1,3,7,15,31,63,127,255]
     #possible_val = [3,12,48,192]
     possible_val = [15, 240]
-    if os.path.isdir("./tmp_train/") == False:
-        os.makedirs('./tmp_train')
-    if os.path.isdir("./tmp_non_direct/") == False:
-        os.makedirs('./tmp_non_direct')
-    if os.path.exists('./br_log'):
-        magic_dict = pickle.load(open("br_log", 'rb'))
-    else:
-        br_log_name = argvv[6] + '_br_log'
-        with open(br_log_name, 'r') as f:
-            lines = f.read().splitlines()
-            for line in lines:
-                tokens = line.split(' ')
-                br_id = int(tokens[2])
-                br_type = int(tokens[4])
-                constant_loc = int(tokens[6])
-                constant_val = tokens[8]
-                lenn = int(tokens[10])
-                if br_id not in magic_dict:
-                    magic_dict[br_id] = (br_type, constant_loc, constant_val, lenn)
-        pickle.dump(magic_dict, open('br_log', 'wb'))
-
-    # read mut_cnt counter
-    global mut_cnt
-    with open("mut_cnt", 'r') as f:
-        mut_cnt = int(f.read())
-
-    # obtain unexplored branches
-    unexplored_1 = {}
-    unexplored_2 = {}
-    explored = []
-    seeds = glob.glob("seeds/*")
-    seeds.sort()
-    find_unexplored_br(unexplored_1, unexplored_2, explored, seeds,tmp_argvv, argvv)
-    if os.path.exists("crack_failed"):
-        crack_failed_but_I_tried = pickle.load(open("crack_failed","rb"))
-    else:
-        crack_failed_but_I_tried = []
+    # the target exits right after compare k has been evaluated (AFL_BR_TARGET)
+    target_env = dict(os.environ, AFL_BR_TARGET=str(k))
+    crack_bool = False
+    # parse branch information from magic_dict (from static analysis LLVM)
+    (br_type, constant_loc, constant_magic, lenn) = magic_dict[k][:4]
+    #if br_type != 2 and br_type != 7 and br_type != 11:
+    #if br_type != 10 and br_type != 12:# and br_type != 11:
+    #    continue
+
+    if br_type == 0 or br_type == 1:
+        seed_id = v[0]
+        init_seed = bytearray(open(seeds[seed_id],'rb').read())
+        print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
+
+        # clean tmp dir
+        for f in glob.glob(tmp_train + "/*"):
+            os.remove(f)
+        # create baseline file
+        with open(tmp_train + "/"+str("121212"),'wb') as f:
+            f.write(init_seed)
+        # generate sample inputs
+        for i in probe_offsets(k, seeds[seed_id], taint_maps, tmp_argvv, argvv):
+            tmp_seed = init_seed.copy()
+            for val in possible_val:
+                tmp_seed[i] = val
+                with open(tmp_train + "/"+str(i)+"_"+str(val),'wb') as f:
+                    f.write(tmp_seed)
+        # parse variable values for each sample inputs
+        tmp_argvv[6] = argvv[6] + '_br_fast'
+        pro = subprocess.run(['./obtain_br','-i',tmp_train, '-o', tmp_train, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore', env=target_env)
+        line = pro.stdout
+        lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
+        tmp_dict = {}
+        # parse result
+        for line in lines:
+            tokens = line.split(':')
+            tokens2 = tokens[1].split(' ')
+            tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
+
+        if '121212' not in tmp_dict:
+            return
+        init_op1 = tmp_dict['121212'][0]
+        init_op2 = tmp_dict['121212'][1]
+        init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
+        hot_offsets = []
+
+        min_dist = float('inf')
+        file_name = ''
+        # no magic constant case
+        if constant_loc == 0:
+            # parse hot bytes
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if ops[0] != init_op1 or ops[1] != init_op2:
+                    # choose the optimal seed as starting point
+                    if abs(distance) < min_dist:
+                        min_dist = abs(distance)
+                        file_name = offset
+
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
+                    if (distance > 0 and init_distance <= 0) or (distance <= 0 and init_distance > 0):
+                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
+                        crack_bool = True
+                        break
 
-    # concatenate two dicts
-    unexplored_1.update(unexplored_2)
-    unexplored = unexplored_1
-    del unexplored[0]
-    #pickle.dump(unexplored, open('tmp_unexplored','wb'))
-    #unexplored = pickle.load(open('tmp_unexplored','rb'))
-    # k==br_id, v==seed_id
-    for k,v in unexplored.items():
-        if k in crack_failed_but_I_tried:
-            continue
-        crack_bool = False
-        # parse branch information from magic_dict (from static analysis LLVM)
-        (br_type, constant_loc, constant_magic, lenn) = magic_dict[k]
-        #if br_type != 2 and br_type != 7 and br_type != 11:
-        #if br_type != 10 and br_type != 12:# and br_type != 11:
-        #    continue
-
-        if br_type == 0 or br_type == 1:
-            seed_id = v[0]
-            init_seed = bytearray(open(seeds[seed_id],'rb').read())
-            print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
-
-            # clean tmp dir
-            for f in glob.glob("./tmp_train/*"):
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+
+            # descend the operand distance over the hot bytes before brute forcing them
+            if solve_br(k, br_type, tmp_train + '/'+file_name, hot_offsets, tmp_argvv, argvv):
+                return
+
+            # generate possible candidtate inputs to crack the branch
+            init_seed = bytearray(open(tmp_train + '/'+file_name,'rb').read())
+            for f in glob.glob(tmp_non_direct + "/*"):
                 os.remove(f)
-            # create baseline file
-            with open("./tmp_train/"+str("121212"),'wb') as f:
-                f.write(init_seed)
-            # generate sample inputs
-            for i in range(len(init_seed)):
+            for hot_offset in hot_offsets[:64]:
                 tmp_seed = init_seed.copy()
-                for val in possible_val:
-                    tmp_seed[i] = val
-                    with open("./tmp_train/"+str(i)+"_"+str(val),'wb') as f:
+                for val in range(255):
+                    tmp_seed[hot_offset] = val
+                    with open(tmp_non_direct + "/"+str(hot_offset)+"_"+str(val),'wb') as f:
                         f.write(tmp_seed)
-            # parse variable values for each sample inputs
+
+            # check results using faster mode binary
             tmp_argvv[6] = argvv[6] + '_br_fast'
-            pro = subprocess.run(['./obtain_br','-i','tmp_train', '-o', './tmp_train', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore')
+            pro = subprocess.run(['./obtain_br','-i',tmp_non_direct, '-o', tmp_non_direct, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore', env=target_env)
             line = pro.stdout
             lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
             tmp_dict = {}
@@ -241,136 +440,111 @@ def crack(tmp_argvv, argvv):
                 tokens2 = tokens[1].split(' ')
                 tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
 
-            if '121212' not in tmp_dict:
-                continue
-            init_op1 = tmp_dict['121212'][0]
-            init_op2 = tmp_dict['121212'][1]
-            init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
-            hot_offsets = []
-
-            min_dist = float('inf')
-            file_name = ''
-            # no magic constant case
-            if constant_loc == 0:
-                # parse hot bytes
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if ops[0] != init_op1 or ops[1] != init_op2:
-                        # choose the optimal seed as starting point
-                        if abs(distance) < min_dist:
-                            min_dist = abs(distance)
-                            file_name = offset
-
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance > 0 and init_distance <= 0) or (distance <= 0 and init_distance > 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if (distance > 0 and init_distance <= 0) or (distance <= 0 and init_distance > 0):
+                    print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                    save_input(tmp_non_direct + "/"+str(offset), 'seeds', k)
+                    crack_bool = True
+                    break
 
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                # generate possible candidtate inputs to crack the branch
-                init_seed = bytearray(open('./tmp_train/'+file_name,'rb').read())
-                for f in glob.glob("./tmp_non_direct/*"):
-                    os.remove(f)
-                for hot_offset in hot_offsets[:64]:
-                    tmp_seed = init_seed.copy()
-                    for val in range(255):
-                        tmp_seed[hot_offset] = val
-                        with open("./tmp_non_direct/"+str(hot_offset)+"_"+str(val),'wb') as f:
-                            f.write(tmp_seed)
 
-                # check results using faster mode binary
-                tmp_argvv[6] = argvv[6] + '_br_fast'
-                pro = subprocess.run(['./obtain_br','-i','tmp_non_direct', '-o', './tmp_non_direct', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore')
-                line = pro.stdout
-                lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
-                tmp_dict = {}
-                # parse result
-                for line in lines:
-                    tokens = line.split(':')
-                    tokens2 = tokens[1].split(' ')
-                    tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
-
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
+        # magic constant case
+        else:
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if distance != init_distance:
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
                     if (distance > 0 and init_distance <= 0) or (distance <= 0 and init_distance > 0):
                         print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                        shutil.copyfile("./tmp_non_direct/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                        mut_cnt = mut_cnt + 1
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
                         crack_bool = True
                         break
 
-
-            # magic constant case
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+            # try every encoding of the magic value natively first
+            if magic_br(k, br_type, constant_magic, tmp_train + '/121212', hot_offsets, tmp_argvv, argvv) != None:
+                return
+
+            if init_distance > 0:
+                # construct an equal case to satisfy <= case
+                magic_ori = struct.pack("@Q", int(constant_magic))
             else:
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if distance != init_distance:
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance > 0 and init_distance <= 0) or (distance <= 0 and init_distance > 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
-
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                if init_distance > 0:
-                    # construct an equal case to satisfy <= case
-                    magic_ori = struct.pack("@Q", int(constant_magic))
+                # construct an > case to safisfy > case
+                if constant_loc == 2:
+                    magic_ori = struct.pack("@Q", int(constant_magic)+1)
+                elif constant_loc == 1:
+                    if int(constant_magic) == 0:
+                        return
+                    magic_ori = struct.pack("@Q", int(constant_magic)-1)
                 else:
-                    # construct an > case to safisfy > case
-                    if constant_loc == 2:
-                        magic_ori = struct.pack("@Q", int(constant_magic)+1)
-                    elif constant_loc == 1:
-                        if int(constant_magic) == 0:
-                            continue
-                        magic_ori = struct.pack("@Q", int(constant_magic)-1)
-                    else:
-                        print("error")
-                        sys.exit(0)
+                    print("error")
+                    sys.exit(0)
+
+            # llvm operand size
+            magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+
+            # write magic bytes to input and check branch coverage
+            for hot_offset in hot_offsets:
+                for magic in magic_l:
+                    tmp_seed = init_seed.copy()
+                    tmp_seed[hot_offset:hot_offset+len(magic)] = magic
+                    with open(tmp_input,'wb') as f:
+                        f.write(tmp_seed)
+
+                    tmp_argvv[6] = argvv[6] + '_br'
+                    out = ''
+                    seed = tmp_input
+                    try:
+                        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                    except subprocess.CalledProcessError:
+                        try:
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                        except subprocess.CalledProcessError:
+                            print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                            save_input(tmp_input, 'crashes', k)
+                    for line in out.splitlines():
+                        tokens = line.split(b':')
+                        edge = int(tokens[0])
+                        hit = int(tokens[1])
+                        if edge == k:
+                            if (init_distance > 0 and hit == 2) or (init_distance <= 0 and hit == 1):
+                                print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                                save_input(tmp_input, 'seeds', k)
+                                crack_bool = True
+                                break
 
-                # llvm operand size
-                magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+                    # crack success, early exit
+                    if crack_bool:
+                        break
 
-                # write magic bytes to input and check branch coverage
-                for hot_offset in hot_offsets:
-                    for magic in magic_l:
+                    if (hot_offset+1) >= len(magic):
                         tmp_seed = init_seed.copy()
-                        tmp_seed[hot_offset:hot_offset+len(magic)] = magic
-                        with open("tmp_input",'wb') as f:
+                        tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
+                        with open(tmp_input,'wb') as f:
                             f.write(tmp_seed)
 
                         tmp_argvv[6] = argvv[6] + '_br'
                         out = ''
-                        seed = './tmp_input'
+                        seed = tmp_input
                         try:
-                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
                         except subprocess.CalledProcessError:
                             try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
+                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
                             except subprocess.CalledProcessError:
-                                print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                mut_cnt = mut_cnt + 1
+                                print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                                save_input(tmp_input, 'crashes', k)
                         for line in out.splitlines():
                             tokens = line.split(b':')
                             edge = int(tokens[0])
@@ -378,79 +552,114 @@ def crack(tmp_argvv, argvv):
                             if edge == k:
                                 if (init_distance > 0 and hit == 2) or (init_distance <= 0 and hit == 1):
                                     print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                    shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
+                                    save_input(tmp_input, 'seeds', k)
                                     crack_bool = True
                                     break
 
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-
-                        if (hot_offset+1) >= len(magic):
-                            tmp_seed = init_seed.copy()
-                            tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
-                            with open("tmp_input",'wb') as f:
-                                f.write(tmp_seed)
-
-                            tmp_argvv[6] = argvv[6] + '_br'
-                            out = ''
-                            seed = './tmp_input'
-                            try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
-                            except subprocess.CalledProcessError:
-                                try:
-                                    out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
-                                except subprocess.CalledProcessError:
-                                    print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                    shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
-                            for line in out.splitlines():
-                                tokens = line.split(b':')
-                                edge = int(tokens[0])
-                                hit = int(tokens[1])
-                                if edge == k:
-                                    if (init_distance > 0 and hit == 2) or (init_distance <= 0 and hit == 1):
-                                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                        shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                        mut_cnt = mut_cnt + 1
-                                        crack_bool = True
-                                        break
-
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-                    # crack early exit
+                    # crack success, early exit
                     if crack_bool:
                         break
+                # crack early exit
+                if crack_bool:
+                    break
+
+    if br_type == 2 or br_type == 7 or br_type == 11:
+
+        t0 = time.time()
+
+        seed_id = v[0]
+        init_seed = bytearray(open(seeds[seed_id],'rb').read())
+        print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
+
+        # clean tmp dir
+        for f in glob.glob(tmp_train + "/*"):
+            os.remove(f)
+        # create baseline file
+        with open(tmp_train + "/"+str("121212"),'wb') as f:
+            f.write(init_seed)
+        # generate sample inputs
+        for i in probe_offsets(k, seeds[seed_id], taint_maps, tmp_argvv, argvv):
+            tmp_seed = init_seed.copy()
+            for val in possible_val:
+                tmp_seed[i] = val
+                with open(tmp_train + "/"+str(i)+"_"+str(val),'wb') as f:
+                    f.write(tmp_seed)
+        # parse variable values for each sample inputs
+        tmp_argvv[6] = argvv[6] + '_br_fast'
+        pro = subprocess.run(['./obtain_br','-i',tmp_train, '-o', tmp_train, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore', env=target_env)
+        t1 = time.time()
+        print("obtain_br time cost " + str(t1-t0))
+
+        line = pro.stdout
+        lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
+        tmp_dict = {}
+        # parse result
+        for line in lines:
+            tokens = line.split(':')
+            tokens2 = tokens[1].split(' ')
+            tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
+
+        t2 = time.time()
+        print("parse obtain_br result time cost " + str(t2-t1))
+
+
+        if '121212' not in tmp_dict:
+            return
+        init_op1 = tmp_dict['121212'][0]
+        init_op2 = tmp_dict['121212'][1]
+        init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
+        hot_offsets = []
+
+        min_dist = float('inf')
+        file_name = ''
+        # no magic constant case
+        if constant_loc == 0:
+            # parse hot bytes
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if ops[0] != init_op1 or ops[1] != init_op2:
+                    # choose the optimal seed as starting point
+                    if abs(distance) < min_dist:
+                        min_dist = abs(distance)
+                        file_name = offset
+
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
+                    if (distance == 0 and init_distance != 0) or (distance != 0 and init_distance == 0):
+                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
+                        crack_bool = True
+                        break
 
-        if br_type == 2 or br_type == 7 or br_type == 11:
-
-            t0 = time.time()
-
-            seed_id = v[0]
-            init_seed = bytearray(open(seeds[seed_id],'rb').read())
-            print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
-
-            # clean tmp dir
-            for f in glob.glob("./tmp_train/*"):
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+
+            # descend the operand distance over the hot bytes before brute forcing them
+            if solve_br(k, br_type, tmp_train + '/'+file_name, hot_offsets, tmp_argvv, argvv):
+                return
+
+            # generate possible candidtate inputs to crack the branch
+            init_seed = bytearray(open(tmp_train + '/'+file_name,'rb').read())
+            for f in glob.glob(tmp_non_direct + "/*"):
                 os.remove(f)
-            # create baseline file
-            with open("./tmp_train/"+str("121212"),'wb') as f:
-                f.write(init_seed)
-            # generate sample inputs
-            for i in range(len(init_seed)):
+            for hot_offset in hot_offsets[:64]:
                 tmp_seed = init_seed.copy()
-                for val in possible_val:
-                    tmp_seed[i] = val
-                    with open("./tmp_train/"+str(i)+"_"+str(val),'wb') as f:
+                for val in range(255):
+                    tmp_seed[hot_offset] = val
+                    with open(tmp_non_direct + "/"+str(hot_offset)+"_"+str(val),'wb') as f:
                         f.write(tmp_seed)
-            # parse variable values for each sample inputs
-            tmp_argvv[6] = argvv[6] + '_br_fast'
-            pro = subprocess.run(['./obtain_br','-i','tmp_train', '-o', './tmp_train', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore')
-            t1 = time.time()
-            print("obtain_br time cost " + str(t1-t0))
 
+            # check results using faster mode binary
+            tmp_argvv[6] = argvv[6] + '_br_fast'
+            pro = subprocess.run(['./obtain_br','-i',tmp_non_direct, '-o', tmp_non_direct, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore', env=target_env)
             line = pro.stdout
             lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
             tmp_dict = {}
@@ -460,134 +669,105 @@ def crack(tmp_argvv, argvv):
                 tokens2 = tokens[1].split(' ')
                 tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
 
-            t2 = time.time()
-            print("parse obtain_br result time cost " + str(t2-t1))
-
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if (distance == 0 and init_distance != 0) or (distance != 0 and init_distance == 0):
+                    print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                    save_input(tmp_non_direct + "/"+str(offset), 'seeds', k)
+                    crack_bool = True
+                    break
 
-            if '121212' not in tmp_dict:
-                continue
-            init_op1 = tmp_dict['121212'][0]
-            init_op2 = tmp_dict['121212'][1]
-            init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
-            hot_offsets = []
-
-            min_dist = float('inf')
-            file_name = ''
-            # no magic constant case
-            if constant_loc == 0:
-                # parse hot bytes
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if ops[0] != init_op1 or ops[1] != init_op2:
-                        # choose the optimal seed as starting point
-                        if abs(distance) < min_dist:
-                            min_dist = abs(distance)
-                            file_name = offset
-
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance == 0 and init_distance != 0) or (distance != 0 and init_distance == 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
-
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                # generate possible candidtate inputs to crack the branch
-                init_seed = bytearray(open('./tmp_train/'+file_name,'rb').read())
-                for f in glob.glob("./tmp_non_direct/*"):
-                    os.remove(f)
-                for hot_offset in hot_offsets[:64]:
-                    tmp_seed = init_seed.copy()
-                    for val in range(255):
-                        tmp_seed[hot_offset] = val
-                        with open("./tmp_non_direct/"+str(hot_offset)+"_"+str(val),'wb') as f:
-                            f.write(tmp_seed)
 
-                # check results using faster mode binary
-                tmp_argvv[6] = argvv[6] + '_br_fast'
-                pro = subprocess.run(['./obtain_br','-i','tmp_non_direct', '-o', './tmp_non_direct', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore')
-                line = pro.stdout
-                lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
-                tmp_dict = {}
-                # parse result
-                for line in lines:
-                    tokens = line.split(':')
-                    tokens2 = tokens[1].split(' ')
-                    tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
-
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
+        # magic constant case
+        else:
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if distance != init_distance:
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
                     if (distance == 0 and init_distance != 0) or (distance != 0 and init_distance == 0):
                         print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                        shutil.copyfile("./tmp_non_direct/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                        mut_cnt = mut_cnt + 1
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
                         crack_bool = True
                         break
 
-
-            # magic constant case
+            t3 = time.time()
+            print("parse distance result time cost " + str(t3-t2))
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+            # try every encoding of the magic value natively first
+            if magic_br(k, br_type, constant_magic, tmp_train + '/121212', hot_offsets, tmp_argvv, argvv) != None:
+                return
+
+            if init_distance != 0:
+                # construct an equal case to satisfy == case
+                magic_ori = struct.pack("@Q", int(constant_magic))
             else:
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if distance != init_distance:
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance == 0 and init_distance != 0) or (distance != 0 and init_distance == 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
+                # construct an inequality case to safisfy != case
+                magic_ori = struct.pack("@Q", int(constant_magic)+1)
 
-                t3 = time.time()
-                print("parse distance result time cost " + str(t3-t2))
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                if init_distance != 0:
-                    # construct an equal case to satisfy == case
-                    magic_ori = struct.pack("@Q", int(constant_magic))
-                else:
-                    # construct an inequality case to safisfy != case
-                    magic_ori = struct.pack("@Q", int(constant_magic)+1)
+            # llvm operand size
+            magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+
+            # write magic bytes to input and check branch coverage
+            for hot_offset in hot_offsets:
+                for magic in magic_l:
+                    tmp_seed = init_seed.copy()
+                    tmp_seed[hot_offset:hot_offset+len(magic)] = magic
+                    with open(tmp_input,'wb') as f:
+                        f.write(tmp_seed)
 
-                # llvm operand size
-                magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+                    tmp_argvv[6] = argvv[6] + '_br'
+                    out = ''
+                    seed = tmp_input
+                    try:
+                        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                    except subprocess.CalledProcessError:
+                        try:
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                        except subprocess.CalledProcessError:
+                            print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                            save_input(tmp_input, 'crashes', k)
+                    for line in out.splitlines():
+                        tokens = line.split(b':')
+                        edge = int(tokens[0])
+                        hit = int(tokens[1])
+                        if edge == k:
+                            if (init_distance == 0 and hit == 2) or (init_distance != 0 and hit == 1):
+                                print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                                save_input(tmp_input, 'seeds', k)
+                                crack_bool = True
+                                break
 
-                # write magic bytes to input and check branch coverage
-                for hot_offset in hot_offsets:
-                    for magic in magic_l:
+                    # crack success, early exit
+                    if crack_bool:
+                        break
+
+                    if (hot_offset+1) >= len(magic):
                         tmp_seed = init_seed.copy()
-                        tmp_seed[hot_offset:hot_offset+len(magic)] = magic
-                        with open("tmp_input",'wb') as f:
+                        tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
+                        with open(tmp_input,'wb') as f:
                             f.write(tmp_seed)
 
                         tmp_argvv[6] = argvv[6] + '_br'
                         out = ''
-                        seed = './tmp_input'
+                        seed = tmp_input
                         try:
-                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
                         except subprocess.CalledProcessError:
                             try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
+                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
                             except subprocess.CalledProcessError:
-                                print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                mut_cnt = mut_cnt + 1
+                                print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                                save_input(tmp_input, 'crashes', k)
                         for line in out.splitlines():
                             tokens = line.split(b':')
                             edge = int(tokens[0])
@@ -595,77 +775,108 @@ def crack(tmp_argvv, argvv):
                             if edge == k:
                                 if (init_distance == 0 and hit == 2) or (init_distance != 0 and hit == 1):
                                     print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                    shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
+                                    save_input(tmp_input, 'seeds', k)
                                     crack_bool = True
                                     break
 
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-
-                        if (hot_offset+1) >= len(magic):
-                            tmp_seed = init_seed.copy()
-                            tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
-                            with open("tmp_input",'wb') as f:
-                                f.write(tmp_seed)
-
-                            tmp_argvv[6] = argvv[6] + '_br'
-                            out = ''
-                            seed = './tmp_input'
-                            try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
-                            except subprocess.CalledProcessError:
-                                try:
-                                    out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
-                                except subprocess.CalledProcessError:
-                                    print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                    shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
-                            for line in out.splitlines():
-                                tokens = line.split(b':')
-                                edge = int(tokens[0])
-                                hit = int(tokens[1])
-                                if edge == k:
-                                    if (init_distance == 0 and hit == 2) or (init_distance != 0 and hit == 1):
-                                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                        shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                        mut_cnt = mut_cnt + 1
-                                        crack_bool = True
-                                        break
-
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-                    # crack early exit
+                    # crack success, early exit
                     if crack_bool:
                         break
-                    t4 = time.time()
-                    print("crack time cost " + str(t4-t3))
-        #'''
-
-
-        if br_type == 3 or br_type == 4:
-            seed_id = v[0]
-            init_seed = bytearray(open(seeds[seed_id],'rb').read())
-            print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
+                # crack early exit
+                if crack_bool:
+                    break
+                t4 = time.time()
+                print("crack time cost " + str(t4-t3))
+    #'''
+
+
+    if br_type == 3 or br_type == 4:
+        seed_id = v[0]
+        init_seed = bytearray(open(seeds[seed_id],'rb').read())
+        print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
+
+        # clean tmp dir
+        for f in glob.glob(tmp_train + "/*"):
+            os.remove(f)
+        # create baseline file
+        with open(tmp_train + "/"+str("121212"),'wb') as f:
+            f.write(init_seed)
+        # generate sample inputs
+        for i in probe_offsets(k, seeds[seed_id], taint_maps, tmp_argvv, argvv):
+            tmp_seed = init_seed.copy()
+            for val in possible_val:
+                tmp_seed[i] = val
+                with open(tmp_train + "/"+str(i)+"_"+str(val),'wb') as f:
+                    f.write(tmp_seed)
+        # parse variable values for each sample inputs
+        tmp_argvv[6] = argvv[6] + '_br_fast'
+        pro = subprocess.run(['./obtain_br','-i',tmp_train, '-o', tmp_train, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore', env=target_env)
+        line = pro.stdout
+        lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
+        tmp_dict = {}
+        # parse result
+        for line in lines:
+            tokens = line.split(':')
+            tokens2 = tokens[1].split(' ')
+            tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
+
+        if '121212' not in tmp_dict:
+            return
+        init_op1 = tmp_dict['121212'][0]
+        init_op2 = tmp_dict['121212'][1]
+        init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
+        hot_offsets = []
+
+        min_dist = float('inf')
+        file_name = ''
+        # no magic constant case
+        if constant_loc == 0:
+            # parse hot bytes
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if ops[0] != init_op1 or ops[1] != init_op2:
+                    # choose the optimal seed as starting point
+                    if abs(distance) < min_dist:
+                        min_dist = abs(distance)
+                        file_name = offset
+
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
+                    if (distance >= 0 and init_distance < 0) or (distance < 0 and init_distance >= 0):
+                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
+                        crack_bool = True
+                        break
 
-            # clean tmp dir
-            for f in glob.glob("./tmp_train/*"):
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+
+            # descend the operand distance over the hot bytes before brute forcing them
+            if solve_br(k, br_type, tmp_train + '/'+file_name, hot_offsets, tmp_argvv, argvv):
+                return
+
+            # generate possible candidtate inputs to crack the branch
+            init_seed = bytearray(open(tmp_train + '/'+file_name,'rb').read())
+            for f in glob.glob(tmp_non_direct + "/*"):
                 os.remove(f)
-            # create baseline file
-            with open("./tmp_train/"+str("121212"),'wb') as f:
-                f.write(init_seed)
-            # generate sample inputs
-            for i in range(len(init_seed)):
+            for hot_offset in hot_offsets[:64]:
                 tmp_seed = init_seed.copy()
-                for val in possible_val:
-                    tmp_seed[i] = val
-                    with open("./tmp_train/"+str(i)+"_"+str(val),'wb') as f:
+                for val in range(255):
+                    tmp_seed[hot_offset] = val
+                    with open(tmp_non_direct + "/"+str(hot_offset)+"_"+str(val),'wb') as f:
                         f.write(tmp_seed)
-            # parse variable values for each sample inputs
+
+            # check results using faster mode binary
             tmp_argvv[6] = argvv[6] + '_br_fast'
-            pro = subprocess.run(['./obtain_br','-i','tmp_train', '-o', './tmp_train', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore')
+            pro = subprocess.run(['./obtain_br','-i',tmp_non_direct, '-o', tmp_non_direct, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore', env=target_env)
             line = pro.stdout
             lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
             tmp_dict = {}
@@ -675,136 +886,111 @@ def crack(tmp_argvv, argvv):
                 tokens2 = tokens[1].split(' ')
                 tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
 
-            if '121212' not in tmp_dict:
-                continue
-            init_op1 = tmp_dict['121212'][0]
-            init_op2 = tmp_dict['121212'][1]
-            init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
-            hot_offsets = []
-
-            min_dist = float('inf')
-            file_name = ''
-            # no magic constant case
-            if constant_loc == 0:
-                # parse hot bytes
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if ops[0] != init_op1 or ops[1] != init_op2:
-                        # choose the optimal seed as starting point
-                        if abs(distance) < min_dist:
-                            min_dist = abs(distance)
-                            file_name = offset
-
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance >= 0 and init_distance < 0) or (distance < 0 and init_distance >= 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if (distance >= 0 and init_distance < 0) or (distance < 0 and init_distance >= 0):
+                    print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                    save_input(tmp_non_direct + "/"+str(offset), 'seeds', k)
+                    crack_bool = True
+                    break
 
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                # generate possible candidtate inputs to crack the branch
-                init_seed = bytearray(open('./tmp_train/'+file_name,'rb').read())
-                for f in glob.glob("./tmp_non_direct/*"):
-                    os.remove(f)
-                for hot_offset in hot_offsets[:64]:
-                    tmp_seed = init_seed.copy()
-                    for val in range(255):
-                        tmp_seed[hot_offset] = val
-                        with open("./tmp_non_direct/"+str(hot_offset)+"_"+str(val),'wb') as f:
-                            f.write(tmp_seed)
 
-                # check results using faster mode binary
-                tmp_argvv[6] = argvv[6] + '_br_fast'
-                pro = subprocess.run(['./obtain_br','-i','tmp_non_direct', '-o', './tmp_non_direct', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore')
-                line = pro.stdout
-                lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
-                tmp_dict = {}
-                # parse result
-                for line in lines:
-                    tokens = line.split(':')
-                    tokens2 = tokens[1].split(' ')
-                    tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
-
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
+        # magic constant case
+        else:
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if distance != init_distance:
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
                     if (distance >= 0 and init_distance < 0) or (distance < 0 and init_distance >= 0):
                         print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                        shutil.copyfile("./tmp_non_direct/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                        mut_cnt = mut_cnt + 1
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
                         crack_bool = True
                         break
 
-
-            # magic constant case
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+            # try every encoding of the magic value natively first
+            if magic_br(k, br_type, constant_magic, tmp_train + '/121212', hot_offsets, tmp_argvv, argvv) != None:
+                return
+
+            if init_distance < 0:
+                # construct a equal case to staisfy >=
+                magic_ori = struct.pack("@Q", int(constant_magic))
             else:
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if distance != init_distance:
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance >= 0 and init_distance < 0) or (distance < 0 and init_distance >= 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
-
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                if init_distance < 0:
-                    # construct a equal case to staisfy >=
-                    magic_ori = struct.pack("@Q", int(constant_magic))
+                # construct an < case to safisfy < case
+                if constant_loc == 2:
+                    if int(constant_magic) == 0:
+                        return
+                    magic_ori = struct.pack("@Q", int(constant_magic)-1)
+                elif constant_loc == 1:
+                    magic_ori = struct.pack("@Q", int(constant_magic)+1)
                 else:
-                    # construct an < case to safisfy < case
-                    if constant_loc == 2:
-                        if int(constant_magic) == 0:
-                            continue
-                        magic_ori = struct.pack("@Q", int(constant_magic)-1)
-                    elif constant_loc == 1:
-                        magic_ori = struct.pack("@Q", int(constant_magic)+1)
-                    else:
-                        print("error")
-                        sys.exit(0)
+                    print("error")
+                    sys.exit(0)
+
+            # llvm operand size
+            magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+
+            # write magic bytes to input and check branch coverage
+            for hot_offset in hot_offsets:
+                for magic in magic_l:
+                    tmp_seed = init_seed.copy()
+                    tmp_seed[hot_offset:hot_offset+len(magic)] = magic
+                    with open(tmp_input,'wb') as f:
+                        f.write(tmp_seed)
+
+                    tmp_argvv[6] = argvv[6] + '_br'
+                    out = ''
+                    seed = tmp_input
+                    try:
+                        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                    except subprocess.CalledProcessError:
+                        try:
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                        except subprocess.CalledProcessError:
+                            print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                            save_input(tmp_input, 'crashes', k)
+                    for line in out.splitlines():
+                        tokens = line.split(b':')
+                        edge = int(tokens[0])
+                        hit = int(tokens[1])
+                        if edge == k:
+                            if (init_distance >= 0 and hit == 2) or (init_distance < 0 and hit == 1):
+                                print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                                save_input(tmp_input, 'seeds', k)
+                                crack_bool = True
+                                break
 
-                # llvm operand size
-                magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+                    # crack success, early exit
+                    if crack_bool:
+                        break
 
-                # write magic bytes to input and check branch coverage
-                for hot_offset in hot_offsets:
-                    for magic in magic_l:
+                    if (hot_offset+1) >= len(magic):
                         tmp_seed = init_seed.copy()
-                        tmp_seed[hot_offset:hot_offset+len(magic)] = magic
-                        with open("tmp_input",'wb') as f:
+                        tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
+                        with open(tmp_input,'wb') as f:
                             f.write(tmp_seed)
 
                         tmp_argvv[6] = argvv[6] + '_br'
                         out = ''
-                        seed = './tmp_input'
+                        seed = tmp_input
                         try:
-                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
                         except subprocess.CalledProcessError:
                             try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
+                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
                             except subprocess.CalledProcessError:
-                                print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                mut_cnt = mut_cnt + 1
+                                print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                                save_input(tmp_input, 'crashes', k)
                         for line in out.splitlines():
                             tokens = line.split(b':')
                             edge = int(tokens[0])
@@ -812,73 +998,104 @@ def crack(tmp_argvv, argvv):
                             if edge == k:
                                 if (init_distance >= 0 and hit == 2) or (init_distance < 0 and hit == 1):
                                     print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                    shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
+                                    save_input(tmp_input, 'seeds', k)
                                     crack_bool = True
                                     break
 
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-
-                        if (hot_offset+1) >= len(magic):
-                            tmp_seed = init_seed.copy()
-                            tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
-                            with open("tmp_input",'wb') as f:
-                                f.write(tmp_seed)
-
-                            tmp_argvv[6] = argvv[6] + '_br'
-                            out = ''
-                            seed = './tmp_input'
-                            try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
-                            except subprocess.CalledProcessError:
-                                try:
-                                    out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
-                                except subprocess.CalledProcessError:
-                                    print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                    shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
-                            for line in out.splitlines():
-                                tokens = line.split(b':')
-                                edge = int(tokens[0])
-                                hit = int(tokens[1])
-                                if edge == k:
-                                    if (init_distance >= 0 and hit == 2) or (init_distance < 0 and hit == 1):
-                                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                        shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                        mut_cnt = mut_cnt + 1
-                                        crack_bool = True
-                                        break
-
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-                    # crack early exit
+                    # crack success, early exit
                     if crack_bool:
                         break
+                # crack early exit
+                if crack_bool:
+                    break
+
+    if br_type == 5 or br_type == 6:
+        seed_id = v[0]
+        init_seed = bytearray(open(seeds[seed_id],'rb').read())
+        print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
+
+        # clean tmp dir
+        for f in glob.glob(tmp_train + "/*"):
+            os.remove(f)
+        # create baseline file
+        with open(tmp_train + "/"+str("121212"),'wb') as f:
+            f.write(init_seed)
+        # generate sample inputs
+        for i in probe_offsets(k, seeds[seed_id], taint_maps, tmp_argvv, argvv):
+            tmp_seed = init_seed.copy()
+            for val in possible_val:
+                tmp_seed[i] = val
+                with open(tmp_train + "/"+str(i)+"_"+str(val),'wb') as f:
+                    f.write(tmp_seed)
+        # parse variable values for each sample inputs
+        tmp_argvv[6] = argvv[6] + '_br_fast'
+        pro = subprocess.run(['./obtain_br','-i',tmp_train, '-o', tmp_train, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore', env=target_env)
+        line = pro.stdout
+        lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
+        tmp_dict = {}
+        # parse result
+        for line in lines:
+            tokens = line.split(':')
+            tokens2 = tokens[1].split(' ')
+            tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
+
+        if '121212' not in tmp_dict:
+            return
+        init_op1 = tmp_dict['121212'][0]
+        init_op2 = tmp_dict['121212'][1]
+        init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
+        hot_offsets = []
+
+        min_dist = float('inf')
+        file_name = ''
+        # no magic constant case
+        if constant_loc == 0:
+            # parse hot bytes
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if ops[0] != init_op1 or ops[1] != init_op2:
+                    # choose the optimal seed as starting point
+                    if abs(distance) < min_dist:
+                        min_dist = abs(distance)
+                        file_name = offset
+
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
+                    if (distance < 0 and init_distance >= 0) or (distance >= 0 and init_distance < 0):
+                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
+                        crack_bool = True
+                        break
 
-        if br_type == 5 or br_type == 6:
-            seed_id = v[0]
-            init_seed = bytearray(open(seeds[seed_id],'rb').read())
-            print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
-
-            # clean tmp dir
-            for f in glob.glob("./tmp_train/*"):
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+
+            # descend the operand distance over the hot bytes before brute forcing them
+            if solve_br(k, br_type, tmp_train + '/'+file_name, hot_offsets, tmp_argvv, argvv):
+                return
+
+            # generate possible candidtate inputs to crack the branch
+            init_seed = bytearray(open(tmp_train + '/'+file_name,'rb').read())
+            for f in glob.glob(tmp_non_direct + "/*"):
                 os.remove(f)
-            # create baseline file
-            with open("./tmp_train/"+str("121212"),'wb') as f:
-                f.write(init_seed)
-            # generate sample inputs
-            for i in range(len(init_seed)):
+            for hot_offset in hot_offsets[:64]:
                 tmp_seed = init_seed.copy()
-                for val in possible_val:
-                    tmp_seed[i] = val
-                    with open("./tmp_train/"+str(i)+"_"+str(val),'wb') as f:
+                for val in range(255):
+                    tmp_seed[hot_offset] = val
+                    with open(tmp_non_direct + "/"+str(hot_offset)+"_"+str(val),'wb') as f:
                         f.write(tmp_seed)
-            # parse variable values for each sample inputs
+
+            # check results using faster mode binary
             tmp_argvv[6] = argvv[6] + '_br_fast'
-            pro = subprocess.run(['./obtain_br','-i','tmp_train', '-o', './tmp_train', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore')
+            pro = subprocess.run(['./obtain_br','-i',tmp_non_direct, '-o', tmp_non_direct, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore', env=target_env)
             line = pro.stdout
             lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
             tmp_dict = {}
@@ -888,136 +1105,111 @@ def crack(tmp_argvv, argvv):
                 tokens2 = tokens[1].split(' ')
                 tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
 
-            if '121212' not in tmp_dict:
-                continue
-            init_op1 = tmp_dict['121212'][0]
-            init_op2 = tmp_dict['121212'][1]
-            init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
-            hot_offsets = []
-
-            min_dist = float('inf')
-            file_name = ''
-            # no magic constant case
-            if constant_loc == 0:
-                # parse hot bytes
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if ops[0] != init_op1 or ops[1] != init_op2:
-                        # choose the optimal seed as starting point
-                        if abs(distance) < min_dist:
-                            min_dist = abs(distance)
-                            file_name = offset
-
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance < 0 and init_distance >= 0) or (distance >= 0 and init_distance < 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if (distance < 0 and init_distance >= 0) or (distance >= 0 and init_distance < 0):
+                    print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                    save_input(tmp_non_direct + "/"+str(offset), 'seeds', k)
+                    crack_bool = True
+                    break
 
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                # generate possible candidtate inputs to crack the branch
-                init_seed = bytearray(open('./tmp_train/'+file_name,'rb').read())
-                for f in glob.glob("./tmp_non_direct/*"):
-                    os.remove(f)
-                for hot_offset in hot_offsets[:64]:
-                    tmp_seed = init_seed.copy()
-                    for val in range(255):
-                        tmp_seed[hot_offset] = val
-                        with open("./tmp_non_direct/"+str(hot_offset)+"_"+str(val),'wb') as f:
-                            f.write(tmp_seed)
 
-                # check results using faster mode binary
-                tmp_argvv[6] = argvv[6] + '_br_fast'
-                pro = subprocess.run(['./obtain_br','-i','tmp_non_direct', '-o', './tmp_non_direct', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore')
-                line = pro.stdout
-                lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
-                tmp_dict = {}
-                # parse result
-                for line in lines:
-                    tokens = line.split(':')
-                    tokens2 = tokens[1].split(' ')
-                    tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
-
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
+        # magic constant case
+        else:
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if distance != init_distance:
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
                     if (distance < 0 and init_distance >= 0) or (distance >= 0 and init_distance < 0):
                         print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                        shutil.copyfile("./tmp_non_direct/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                        mut_cnt = mut_cnt + 1
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
                         crack_bool = True
                         break
 
-
-            # magic constant case
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+            # try every encoding of the magic value natively first
+            if magic_br(k, br_type, constant_magic, tmp_train + '/121212', hot_offsets, tmp_argvv, argvv) != None:
+                return
+
+            if init_distance < 0:
+                # construct an equal case to satisfy >= case
+                magic_ori = struct.pack("@Q", int(constant_magic))
             else:
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if distance != init_distance:
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance < 0 and init_distance >= 0) or (distance >= 0 and init_distance < 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
-
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                if init_distance < 0:
-                    # construct an equal case to satisfy >= case
-                    magic_ori = struct.pack("@Q", int(constant_magic))
+                # construct an < case to safisfy < case
+                if constant_loc == 2:
+                    if int(constant_magic) == 0:
+                        return
+                    magic_ori = struct.pack("@Q", int(constant_magic)-1)
+                elif constant_loc == 1:
+                    magic_ori = struct.pack("@Q", int(constant_magic)+1)
                 else:
-                    # construct an < case to safisfy < case
-                    if constant_loc == 2:
-                        if int(constant_magic) == 0:
-                            continue
-                        magic_ori = struct.pack("@Q", int(constant_magic)-1)
-                    elif constant_loc == 1:
-                        magic_ori = struct.pack("@Q", int(constant_magic)+1)
-                    else:
-                        print("error")
-                        sys.exit(0)
+                    print("error")
+                    sys.exit(0)
+
+            # llvm operand size
+            magic_l = [magic_ori[:l] for l in [1,2,4,8]]
 
-                # llvm operand size
-                magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+            # write magic bytes to input and check branch coverage
+            for hot_offset in hot_offsets:
+                for magic in magic_l:
+                    tmp_seed = init_seed.copy()
+                    tmp_seed[hot_offset:hot_offset+len(magic)] = magic
+                    with open(tmp_input,'wb') as f:
+                        f.write(tmp_seed)
+
+                    tmp_argvv[6] = argvv[6] + '_br'
+                    out = ''
+                    seed = tmp_input
+                    try:
+                        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                    except subprocess.CalledProcessError:
+                        try:
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                        except subprocess.CalledProcessError:
+                            print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                            save_input(tmp_input, 'crashes', k)
+                    for line in out.splitlines():
+                        tokens = line.split(b':')
+                        edge = int(tokens[0])
+                        hit = int(tokens[1])
+                        if edge == k:
+                            if (init_distance < 0 and hit == 2) or (init_distance >= 0 and hit == 1):
+                                print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                                save_input(tmp_input, 'seeds', k)
+                                crack_bool = True
+                                break
 
-                # write magic bytes to input and check branch coverage
-                for hot_offset in hot_offsets:
-                    for magic in magic_l:
+                    # crack success, early exit
+                    if crack_bool:
+                        break
+
+                    if (hot_offset+1) >= len(magic):
                         tmp_seed = init_seed.copy()
-                        tmp_seed[hot_offset:hot_offset+len(magic)] = magic
-                        with open("tmp_input",'wb') as f:
+                        tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
+                        with open(tmp_input,'wb') as f:
                             f.write(tmp_seed)
 
                         tmp_argvv[6] = argvv[6] + '_br'
                         out = ''
-                        seed = './tmp_input'
+                        seed = tmp_input
                         try:
-                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
                         except subprocess.CalledProcessError:
                             try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
+                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
                             except subprocess.CalledProcessError:
-                                print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                mut_cnt = mut_cnt + 1
+                                print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                                save_input(tmp_input, 'crashes', k)
                         for line in out.splitlines():
                             tokens = line.split(b':')
                             edge = int(tokens[0])
@@ -1025,73 +1217,105 @@ def crack(tmp_argvv, argvv):
                             if edge == k:
                                 if (init_distance < 0 and hit == 2) or (init_distance >= 0 and hit == 1):
                                     print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                    shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
+                                    save_input(tmp_input, 'seeds', k)
                                     crack_bool = True
                                     break
 
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-
-                        if (hot_offset+1) >= len(magic):
-                            tmp_seed = init_seed.copy()
-                            tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
-                            with open("tmp_input",'wb') as f:
-                                f.write(tmp_seed)
-
-                            tmp_argvv[6] = argvv[6] + '_br'
-                            out = ''
-                            seed = './tmp_input'
-                            try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
-                            except subprocess.CalledProcessError:
-                                try:
-                                    out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
-                                except subprocess.CalledProcessError:
-                                    print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                    shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
-                            for line in out.splitlines():
-                                tokens = line.split(b':')
-                                edge = int(tokens[0])
-                                hit = int(tokens[1])
-                                if edge == k:
-                                    if (init_distance < 0 and hit == 2) or (init_distance >= 0 and hit == 1):
-                                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                        shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                        mut_cnt = mut_cnt + 1
-                                        crack_bool = True
-                                        break
-
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-                    # crack early exit
+                    # crack success, early exit
                     if crack_bool:
                         break
+                # crack early exit
+                if crack_bool:
+                    break
+
+    if br_type == 8 or br_type == 9:
+        seed_id = v[0]
+        init_seed = bytearray(open(seeds[seed_id],'rb').read())
+        print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
+
+        # clean tmp dir
+        for f in glob.glob(tmp_train + "/*"):
+            os.remove(f)
+        # create baseline file
+        with open(tmp_train + "/"+str("121212"),'wb') as f:
+            f.write(init_seed)
+        # generate sample inputs
+        for i in probe_offsets(k, seeds[seed_id], taint_maps, tmp_argvv, argvv):
+            tmp_seed = init_seed.copy()
+            for val in possible_val:
+                tmp_seed[i] = val
+                with open(tmp_train + "/"+str(i)+"_"+str(val),'wb') as f:
+                    f.write(tmp_seed)
+        # parse variable values for each sample inputs
+        tmp_argvv[6] = argvv[6] + '_br_fast'
+        pro = subprocess.run(['./obtain_br','-i',tmp_train, '-o', tmp_train, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore', env=target_env)
+        line = pro.stdout
+        lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
+        tmp_dict = {}
+        # parse result
+        for line in lines:
+            tokens = line.split(':')
+            tokens2 = tokens[1].split(' ')
+            tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
+
+
+        if '121212' not in tmp_dict:
+            return
+        init_op1 = tmp_dict['121212'][0]
+        init_op2 = tmp_dict['121212'][1]
+        init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
+        hot_offsets = []
+
+        min_dist = float('inf')
+        file_name = ''
+        # no magic constant case
+        if constant_loc == 0:
+            # parse hot bytes
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if ops[0] != init_op1 or ops[1] != init_op2:
+                    # choose the optimal seed as starting point
+                    if abs(distance) < min_dist:
+                        min_dist = abs(distance)
+                        file_name = offset
+
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
+                    if (distance <= 0 and init_distance > 0) or (distance > 0 and init_distance <= 0):
+                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
+                        crack_bool = True
+                        break
 
-        if br_type == 8 or br_type == 9:
-            seed_id = v[0]
-            init_seed = bytearray(open(seeds[seed_id],'rb').read())
-            print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
-
-            # clean tmp dir
-            for f in glob.glob("./tmp_train/*"):
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+
+            # descend the operand distance over the hot bytes before brute forcing them
+            if solve_br(k, br_type, tmp_train + '/'+file_name, hot_offsets, tmp_argvv, argvv):
+                return
+
+            # generate possible candidtate inputs to crack the branch
+            init_seed = bytearray(open(tmp_train + '/'+file_name,'rb').read())
+            for f in glob.glob(tmp_non_direct + "/*"):
                 os.remove(f)
-            # create baseline file
-            with open("./tmp_train/"+str("121212"),'wb') as f:
-                f.write(init_seed)
-            # generate sample inputs
-            for i in range(len(init_seed)):
+            for hot_offset in hot_offsets[:64]:
                 tmp_seed = init_seed.copy()
-                for val in possible_val:
-                    tmp_seed[i] = val
-                    with open("./tmp_train/"+str(i)+"_"+str(val),'wb') as f:
+                for val in range(255):
+                    tmp_seed[hot_offset] = val
+                    with open(tmp_non_direct + "/"+str(hot_offset)+"_"+str(val),'wb') as f:
                         f.write(tmp_seed)
-            # parse variable values for each sample inputs
+
+            # check results using faster mode binary
             tmp_argvv[6] = argvv[6] + '_br_fast'
-            pro = subprocess.run(['./obtain_br','-i','tmp_train', '-o', './tmp_train', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore')
+            pro = subprocess.run(['./obtain_br','-i',tmp_non_direct, '-o', tmp_non_direct, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore', env=target_env)
             line = pro.stdout
             lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
             tmp_dict = {}
@@ -1101,137 +1325,111 @@ def crack(tmp_argvv, argvv):
                 tokens2 = tokens[1].split(' ')
                 tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
 
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if (distance <= 0 and init_distance > 0) or (distance > 0 and init_distance <= 0):
+                    print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                    save_input(tmp_non_direct + "/"+str(offset), 'seeds', k)
+                    crack_bool = True
+                    break
 
-            if '121212' not in tmp_dict:
-                continue
-            init_op1 = tmp_dict['121212'][0]
-            init_op2 = tmp_dict['121212'][1]
-            init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
-            hot_offsets = []
-
-            min_dist = float('inf')
-            file_name = ''
-            # no magic constant case
-            if constant_loc == 0:
-                # parse hot bytes
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if ops[0] != init_op1 or ops[1] != init_op2:
-                        # choose the optimal seed as starting point
-                        if abs(distance) < min_dist:
-                            min_dist = abs(distance)
-                            file_name = offset
-
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance <= 0 and init_distance > 0) or (distance > 0 and init_distance <= 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
-
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                # generate possible candidtate inputs to crack the branch
-                init_seed = bytearray(open('./tmp_train/'+file_name,'rb').read())
-                for f in glob.glob("./tmp_non_direct/*"):
-                    os.remove(f)
-                for hot_offset in hot_offsets[:64]:
-                    tmp_seed = init_seed.copy()
-                    for val in range(255):
-                        tmp_seed[hot_offset] = val
-                        with open("./tmp_non_direct/"+str(hot_offset)+"_"+str(val),'wb') as f:
-                            f.write(tmp_seed)
 
-                # check results using faster mode binary
-                tmp_argvv[6] = argvv[6] + '_br_fast'
-                pro = subprocess.run(['./obtain_br','-i','tmp_non_direct', '-o', './tmp_non_direct', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",errors='ignore')
-                line = pro.stdout
-                lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
-                tmp_dict = {}
-                # parse result
-                for line in lines:
-                    tokens = line.split(':')
-                    tokens2 = tokens[1].split(' ')
-                    tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
-
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
+        # magic constant case
+        else:
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if distance != init_distance:
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
                     if (distance <= 0 and init_distance > 0) or (distance > 0 and init_distance <= 0):
                         print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                        shutil.copyfile("./tmp_non_direct/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                        mut_cnt = mut_cnt + 1
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
                         crack_bool = True
                         break
 
-
-            # magic constant case
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+            # try every encoding of the magic value natively first
+            if magic_br(k, br_type, constant_magic, tmp_train + '/121212', hot_offsets, tmp_argvv, argvv) != None:
+                return
+
+            if init_distance > 0:
+                # construct an equal case to satisfy <= case
+                magic_ori = struct.pack("@Q", int(constant_magic))
             else:
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if distance != init_distance:
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance <= 0 and init_distance > 0) or (distance > 0 and init_distance <= 0):
-                            print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
-                            crack_bool = True
-                            break
-
-                # crack success, skip to next branch
-                if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-
-                if init_distance > 0:
-                    # construct an equal case to satisfy <= case
-                    magic_ori = struct.pack("@Q", int(constant_magic))
+                # construct an > case to safisfy > case
+                if constant_loc == 2:
+                    magic_ori = struct.pack("@Q", int(constant_magic)+1)
+                elif constant_loc == 1:
+                    if int(constant_magic) == 0:
+                        return
+                    magic_ori = struct.pack("@Q", int(constant_magic)-1)
                 else:
-                    # construct an > case to safisfy > case
-                    if constant_loc == 2:
-                        magic_ori = struct.pack("@Q", int(constant_magic)+1)
-                    elif constant_loc == 1:
-                        if int(constant_magic) == 0:
-                            continue
-                        magic_ori = struct.pack("@Q", int(constant_magic)-1)
-                    else:
-                        print("error")
-                        sys.exit(0)
+                    print("error")
+                    sys.exit(0)
+
+            # llvm operand size
+            magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+
+            # write magic bytes to input and check branch coverage
+            for hot_offset in hot_offsets:
+                for magic in magic_l:
+                    tmp_seed = init_seed.copy()
+                    tmp_seed[hot_offset:hot_offset+len(magic)] = magic
+                    with open(tmp_input,'wb') as f:
+                        f.write(tmp_seed)
+
+                    tmp_argvv[6] = argvv[6] + '_br'
+                    out = ''
+                    seed = tmp_input
+                    try:
+                        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                    except subprocess.CalledProcessError:
+                        try:
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                        except subprocess.CalledProcessError:
+                            print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                            save_input(tmp_input, 'crashes', k)
+                    for line in out.splitlines():
+                        tokens = line.split(b':')
+                        edge = int(tokens[0])
+                        hit = int(tokens[1])
+                        if edge == k:
+                            if (init_distance <= 0 and hit == 2) or (init_distance > 0 and hit == 1):
+                                print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                                save_input(tmp_input, 'seeds', k)
+                                crack_bool = True
+                                break
 
-                # llvm operand size
-                magic_l = [magic_ori[:l] for l in [1,2,4,8]]
+                    # crack success, early exit
+                    if crack_bool:
+                        break
 
-                # write magic bytes to input and check branch coverage
-                for hot_offset in hot_offsets:
-                    for magic in magic_l:
+                    if (hot_offset+1) >= len(magic):
                         tmp_seed = init_seed.copy()
-                        tmp_seed[hot_offset:hot_offset+len(magic)] = magic
-                        with open("tmp_input",'wb') as f:
+                        tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
+                        with open(tmp_input,'wb') as f:
                             f.write(tmp_seed)
 
                         tmp_argvv[6] = argvv[6] + '_br'
                         out = ''
-                        seed = './tmp_input'
+                        seed = tmp_input
                         try:
-                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
                         except subprocess.CalledProcessError:
                             try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
+                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
                             except subprocess.CalledProcessError:
-                                print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                mut_cnt = mut_cnt + 1
+                                print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                                save_input(tmp_input, 'crashes', k)
                         for line in out.splitlines():
                             tokens = line.split(b':')
                             edge = int(tokens[0])
@@ -1239,147 +1437,148 @@ def crack(tmp_argvv, argvv):
                             if edge == k:
                                 if (init_distance <= 0 and hit == 2) or (init_distance > 0 and hit == 1):
                                     print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                    shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
+                                    save_input(tmp_input, 'seeds', k)
                                     crack_bool = True
                                     break
 
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-
-                        if (hot_offset+1) >= len(magic):
-                            tmp_seed = init_seed.copy()
-                            tmp_seed[hot_offset-len(magic)+1 :hot_offset+1] = magic
-                            with open("tmp_input",'wb') as f:
-                                f.write(tmp_seed)
-
-                            tmp_argvv[6] = argvv[6] + '_br'
-                            out = ''
-                            seed = './tmp_input'
-                            try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
-                            except subprocess.CalledProcessError:
-                                try:
-                                    out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
-                                except subprocess.CalledProcessError:
-                                    print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                    shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
-                            for line in out.splitlines():
-                                tokens = line.split(b':')
-                                edge = int(tokens[0])
-                                hit = int(tokens[1])
-                                if edge == k:
-                                    if (init_distance <= 0 and hit == 2) or (init_distance > 0 and hit == 1):
-                                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                        shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                        mut_cnt = mut_cnt + 1
-                                        crack_bool = True
-                                        break
-
-                        # crack success, early exit
-                        if crack_bool:
-                            break
-                    # crack early exit
+                    # crack success, early exit
                     if crack_bool:
                         break
+                # crack early exit
+                if crack_bool:
+                    break
+
+    if br_type == 10 or br_type == 12:
+        seed_id = v[0]
+        if isinstance(v[0], tuple):
+            seed_id = v[0][0]
+        init_seed = bytearray(open(seeds[seed_id],'rb').read())
+        print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
+
+        # clean tmp dir
+        for f in glob.glob(tmp_train + "/*"):
+            os.remove(f)
+        # create baseline file
+        with open(tmp_train + "/"+str("121212"),'wb') as f:
+            f.write(init_seed)
+        # generate sample inputs
+        for i in probe_offsets(k, seeds[seed_id], taint_maps, tmp_argvv, argvv):
+            tmp_seed = init_seed.copy()
+            for val in possible_val:
+                tmp_seed[i] = val
+                with open(tmp_train + "/"+str(i)+"_"+str(val),'wb') as f:
+                    f.write(tmp_seed)
+        # parse variable values for each sample inputs
+        tmp_argvv[6] = argvv[6] + '_br_fast'
+        pro = subprocess.run(['./obtain_br','-i',tmp_train, '-o', tmp_train, '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore', env=target_env)
+        line = pro.stdout
+        lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
+        tmp_dict = {}
+        # parse result
+        for line in lines:
+            tokens = line.split(':')
+            tokens2 = tokens[1].split(' ')
+            tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
+
+
+        if '121212' not in tmp_dict:
+            return
+        init_op1 = tmp_dict['121212'][0]
+        init_op2 = tmp_dict['121212'][1]
+        init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
+        hot_offsets = []
+
+        min_dist = float('inf')
+        file_name = ''
+        # no magic constant case
+        if constant_loc == 0:
+            return
+
+        # magic constant case
+        else:
+            for offset, ops in tmp_dict.items():
+                distance = ops[0] - ops[1]
+                if distance != init_distance:
+                    loc_offset = int(offset.split('_')[0])
+                    if loc_offset not in hot_offsets:
+                        hot_offsets.append(loc_offset)
+                    if (distance == 0 and init_distance != 0) or (distance != 0 and init_distance == 0):
+                        print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
+                        save_input(tmp_train + "/"+str(offset), 'seeds', k)
+                        crack_bool = True
+                        break
 
-        if br_type == 10 or br_type == 12:
-            seed_id = v[0]
-            if isinstance(v[0], tuple):
-                seed_id = v[0][0]
-            init_seed = bytearray(open(seeds[seed_id],'rb').read())
-            print("br id: " + str(k) + " br len: " + str(lenn) + " br type: " + str(br_type) + " magic: " +  constant_magic + " magic_loc: " + str(constant_loc) + " file len: " + str(len(init_seed)))
-
-            # clean tmp dir
-            for f in glob.glob("./tmp_train/*"):
-                os.remove(f)
-            # create baseline file
-            with open("./tmp_train/"+str("121212"),'wb') as f:
-                f.write(init_seed)
-            # generate sample inputs
-            for i in range(len(init_seed)):
+            # crack success, skip to next branch
+            if crack_bool:
+                return
+            # no hot byte candidates, skip
+            if len(hot_offsets)==0:
+                return
+            # another worker's input already flipped it
+            if k in resolved:
+                return
+            # construct magic string
+            magic = []
+            for num in range(int(len(constant_magic)/2)):
+                magic.append(int('0x'+constant_magic[num*2:num*2+2],0))
+
+            magic_rev = magic.copy()
+            magic_rev.reverse()
+            for hot_offset in hot_offsets:
                 tmp_seed = init_seed.copy()
-                for val in possible_val:
-                    tmp_seed[i] = val
-                    with open("./tmp_train/"+str(i)+"_"+str(val),'wb') as f:
-                        f.write(tmp_seed)
-            # parse variable values for each sample inputs
-            tmp_argvv[6] = argvv[6] + '_br_fast'
-            pro = subprocess.run(['./obtain_br','-i','tmp_train', '-o', './tmp_train', '-l', str(len(init_seed)), '-t', str(k)] + tmp_argvv[6:], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors='ignore')
-            line = pro.stdout
-            lines = line[line.find('###$$$ obtain br')+18:].split('\n')[:-1]
-            tmp_dict = {}
-            # parse result
-            for line in lines:
-                tokens = line.split(':')
-                tokens2 = tokens[1].split(' ')
-                tmp_dict[tokens[0]] = [int(tokens2[0]), int(tokens2[1])]
-
-
-            if '121212' not in tmp_dict:
-                continue
-            init_op1 = tmp_dict['121212'][0]
-            init_op2 = tmp_dict['121212'][1]
-            init_distance = tmp_dict['121212'][0] - tmp_dict['121212'][1]
-            hot_offsets = []
-
-            min_dist = float('inf')
-            file_name = ''
-            # no magic constant case
-            if constant_loc == 0:
-                continue
-
-            # magic constant case
-            else:
-                for offset, ops in tmp_dict.items():
-                    distance = ops[0] - ops[1]
-                    if distance != init_distance:
-                        loc_offset = int(offset.split('_')[0])
-                        if loc_offset not in hot_offsets:
-                            hot_offsets.append(loc_offset)
-                        if (distance == 0 and init_distance != 0) or (distance != 0 and init_distance == 0):
+                tmp_seed[hot_offset:hot_offset+len(magic)] = magic
+                if br_type == 10:
+                    tmp_seed[hot_offset+len(magic)] = 0
+                with open(tmp_input,'wb') as f:
+                    f.write(tmp_seed)
+
+                # run inputs and check results
+                tmp_argvv[6] = argvv[6] + '_br'
+                out = ''
+                seed = tmp_input
+                try:
+                    out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                except subprocess.CalledProcessError:
+                    try:
+                        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
+                    except subprocess.CalledProcessError:
+                        print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                        save_input(tmp_input, 'crashes', k)
+                for line in out.splitlines():
+                    tokens = line.split(b':')
+                    edge = int(tokens[0])
+                    hit = int(tokens[1])
+                    if edge == k:
+                        if (init_distance == 0 and hit == 2) or (init_distance != 0 and hit == 1):
                             print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                            shutil.copyfile("./tmp_train/"+str(offset), "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
+                            save_input(tmp_input, 'seeds', k)
                             crack_bool = True
                             break
 
-                # crack success, skip to next branch
+                # crack success, early exit
                 if crack_bool:
-                    continue
-                # no hot byte candidates, skip
-                if len(hot_offsets)==0:
-                    continue
-                # construct magic string
-                magic = []
-                for num in range(int(len(constant_magic)/2)):
-                    magic.append(int('0x'+constant_magic[num*2:num*2+2],0))
-
-                magic_rev = magic.copy()
-                magic_rev.reverse()
-                for hot_offset in hot_offsets:
+                    break
+
+                if (hot_offset+1) >= len(magic_rev):
                     tmp_seed = init_seed.copy()
-                    tmp_seed[hot_offset:hot_offset+len(magic)] = magic
+                    tmp_seed[hot_offset-len(magic_rev)+1 :hot_offset+1] = magic_rev
                     if br_type == 10:
-                        tmp_seed[hot_offset+len(magic)] = 0
-                    with open("tmp_input",'wb') as f:
+                        if hot_offset >= len(magic_rev):
+                            tmp_seed[hot_offset-len(magic_rev)] = 0
+                    with open(tmp_input,'wb') as f:
                         f.write(tmp_seed)
 
-                    # run inputs and check results
                     tmp_argvv[6] = argvv[6] + '_br'
                     out = ''
-                    seed = './tmp_input'
+                    seed = tmp_input
                     try:
-                        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
+                        out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed], env=target_env)
                     except subprocess.CalledProcessError:
                         try:
-                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
+                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed], env=target_env)
                         except subprocess.CalledProcessError:
-                            print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                            shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                            mut_cnt = mut_cnt + 1
+                            print("### found a crash " + str(k) + " br_tyte "+ str(br_type))
+                            save_input(tmp_input, 'crashes', k)
                     for line in out.splitlines():
                         tokens = line.split(b':')
                         edge = int(tokens[0])
@@ -1387,72 +1586,224 @@ def crack(tmp_argvv, argvv):
                         if edge == k:
                             if (init_distance == 0 and hit == 2) or (init_distance != 0 and hit == 1):
                                 print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                mut_cnt = mut_cnt + 1
+                                save_input(tmp_input, 'seeds', k)
                                 crack_bool = True
                                 break
 
-                    # crack success, early exit
-                    if crack_bool:
-                        break
+                # crack success, early exit
+                if crack_bool:
+                    break
+# static reward (instructions dominated) of direction hit of a br_log entry;
+# br_log pickles from before the rewards hold 4-tuples
+def br_reward(entry, hit):
+    if entry is None or len(entry) < 6:
+        return 0
+    return entry[3 + hit]
 
-                    if (hot_offset+1) >= len(magic_rev):
-                        tmp_seed = init_seed.copy()
-                        tmp_seed[hot_offset-len(magic_rev)+1 :hot_offset+1] = magic_rev
-                        if br_type == 10:
-                            if hot_offset >= len(magic_rev):
-                                tmp_seed[hot_offset-len(magic_rev)] = 0
-                        with open("tmp_input",'wb') as f:
-                            f.write(tmp_seed)
+# for each unexplored CMP-based branch, mutate hot bytes with intecepted operands
+# (TODO: clean this function, many duplicated code logic)
+def crack(tmp_argvv, argvv):
+    magic_dict = {}
+    if os.path.exists('./br_log'):
+        magic_dict = pickle.load(open("br_log", 'rb'))
+    else:
+        br_log_name = argvv[6] + '_br_log'
+        with open(br_log_name, 'r') as f:
+            lines = f.read().splitlines()
+            for line in lines:
+                tokens = line.split(' ')
+                br_id = int(tokens[2])
+                br_type = int(tokens[4])
+                constant_loc = int(tokens[6])
+                constant_val = tokens[8]
+                lenn = int(tokens[10])
+                # static rewards of outcome 1 and 2, absent in older br_log files
+                reward_1 = 0
+                reward_2 = 0
+                if len(tokens) > 14 and tokens[11] == 'reward_1':
+                    reward_1 = int(tokens[12])
+                    reward_2 = int(tokens[14])
+                if br_id not in magic_dict:
+                    magic_dict[br_id] = (br_type, constant_loc, constant_val, lenn, reward_1, reward_2)
+        pickle.dump(magic_dict, open('br_log', 'wb'))
 
-                        tmp_argvv[6] = argvv[6] + '_br'
-                        out = ''
-                        seed = './tmp_input'
-                        try:
-                            out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '500'] + tmp_argvv[6:-1] + [seed])
-                        except subprocess.CalledProcessError:
-                            try:
-                                out = check_out(['./afl-showbr', '-q', '-o', '/dev/stdout', '-m', '1024', '-t', '5000'] + tmp_argvv[6:-1] + [seed])
-                            except subprocess.CalledProcessError:
-                                print("### found a crash " + str(k) + " br_tyte "+ br_type)
-                                shutil.copyfile("tmp_input", "./crash/id_0_"+str(k)+"_"+str(mut_cnt))
-                                mut_cnt = mut_cnt + 1
-                        for line in out.splitlines():
-                            tokens = line.split(b':')
-                            edge = int(tokens[0])
-                            hit = int(tokens[1])
-                            if edge == k:
-                                if (init_distance == 0 and hit == 2) or (init_distance != 0 and hit == 1):
-                                    print("###crack branch " + str(k) + " br_tyte "+ str(br_type) + " constant_loc " + str(constant_loc))
-                                    shutil.copyfile("tmp_input", "./seeds/id_0_"+str(k)+"_"+str(mut_cnt))
-                                    mut_cnt = mut_cnt + 1
-                                    crack_bool = True
-                                    break
+    # read mut_cnt counter
+    global mut_cnt
+    mut_cnt = load_mut_cnt()
+
+    # obtain unexplored branches
+    unexplored_1 = {}
+    unexplored_2 = {}
+    explored = []
+    seeds = glob.glob("seeds/*")
+    seeds.sort()
+    find_unexplored_br(unexplored_1, unexplored_2, explored, seeds,tmp_argvv, argvv)
+    if os.path.exists("crack_failed"):
+        crack_failed_but_I_tried = pickle.load(open("crack_failed","rb"))
+    else:
+        crack_failed_but_I_tried = []
+
+    # direction each unexplored branch still misses
+    missing = dict([(k, 2) for k in unexplored_1] + [(k, 1) for k in unexplored_2])
+
+    # concatenate two dicts
+    unexplored_1.update(unexplored_2)
+    unexplored = unexplored_1
+    del unexplored[0]
+    #pickle.dump(unexplored, open('tmp_unexplored','wb'))
+    #unexplored = pickle.load(open('tmp_unexplored','rb'))
+    # k==br_id, v==seed_id
+    todo = [(k, v) for k, v in unexplored.items() if k not in crack_failed_but_I_tried]
+    # branches guarding the most code behind their unexplored direction go first
+    todo.sort(key=lambda item: br_reward(magic_dict.get(item[0]), missing[item[0]]), reverse=True)
+
+    # crack the branches on every core of this stage, one worker per core with its
+    # own scratch dirs; the inputs they find are moved to seeds/crashes here
+    sys.stdout.reconfigure(line_buffering=True)
+    manager = multiprocessing.Manager()
+    resolved = manager.dict()
+    counter = multiprocessing.Value('i', 0)
+    n_workers = max(min(len(os.sched_getaffinity(0)), len(todo)), 1)
+    pool = multiprocessing.Pool(n_workers, crack_worker_init, (counter, resolved, missing, magic_dict, seeds, argvv))
+    for found in pool.imap_unordered(crack_worker, todo):
+        for (kind, k, path) in found:
+            # complete in the worker's tmp_found, renamed so nn.py never lists a partial seed
+            os.rename(path, "./" + kind + "/id_0_" + str(k) + "_" + str(mut_cnt))
+            mut_cnt = mut_cnt + 1
+    pool.close()
+    pool.join()
+    print("### crack " + str(len(todo)) + " branches on " + str(n_workers) + " workers, " + str(len(resolved)) + " flipped")
+    manager.shutdown()
 
-                    # crack success, early exit
-                    if crack_bool:
-                        break
 
     crack_failed_but_I_tried = list(unexplored.keys())
     pickle.dump(crack_failed_but_I_tried, open("crack_failed",'wb'))
-    with open("mut_cnt", 'w') as f:
+    with open(mut_cnt_file(), 'w') as f:
         f.write(str(mut_cnt))
 
+# every lane numbers its inputs from its own counter file, so names never collide
+def mut_cnt_file():
+    lane = int(os.environ.get('MTFUZZ_LANE', '0'))
+    return 'mut_cnt_' + str(lane) if lane else 'mut_cnt'
+
+def load_mut_cnt():
+    if not os.path.exists(mut_cnt_file()):
+        return int(os.environ.get('MTFUZZ_LANE', '0')) * LANE_MUT_CNT_BASE
+    with open(mut_cnt_file(), 'r') as f:
+        return int(f.read())
+
+# Run the NN fuzz stage (alternating ec and ctx rounds of mtfuzz) and the crack stage
+# side by side on disjoint cores, sharing inputs through the seeds directory. After
+# every run a stage's yield (new edges or cracked branches per second) is updated
+# and the cores are split between the stages in proportion to it.
+class StageScheduler(object):
+    def __init__(self, argvv):
+        self.argvv = argvv
+        self.cores = sorted(os.sched_getaffinity(0))
+        self.yields = {'fuzz': 1.0, 'crack': 1.0}
+        self.mode = 'ec'
+        self.fuzz = None
+        self.crack = None
+        if os.path.isdir("./lanes/") == False:
+            os.makedirs('./lanes')
+
+    def split(self):
+        if len(self.cores) < 2:
+            return self.cores, self.cores
+        share = self.yields['fuzz'] / (self.yields['fuzz'] + self.yields['crack'])
+        n_fuzz = min(max(int(round(len(self.cores) * share)), 1), len(self.cores) - 1)
+        return self.cores[:n_fuzz], self.cores[n_fuzz:]
+
+    def update(self, stage, gain, secs):
+        rate = gain / max(secs, 1.0)
+        self.yields[stage] = YIELD_DECAY * rate + (1 - YIELD_DECAY) * self.yields[stage]
+        # keep a stage with no recent yield alive on at least a small share
+        self.yields[stage] = max(self.yields[stage], 1e-3)
+        fuzz_cores, crack_cores = self.split()
+        print("%%%%%%%%%%%%% " + stage + " yield " + str(round(rate, 4)) + "/s, cores fuzz " + str(len(fuzz_cores)) + " crack " + str(len(crack_cores)))
+
+    # one lane per core: lane 0 talks to nn.py, the others replay their share of the
+    # current gradient file offline
+    def start_fuzz(self):
+        cores = self.split()[0]
+        if not os.path.exists('gradient_info_p'):
+            cores = cores[:1]
+        tmp_argvv = self.argvv.copy()
+        tmp_argvv[6] = self.argvv[6] + '_' + self.mode
+        procs = []
+        for k, core in enumerate(cores):
+            env = dict(os.environ, MTFUZZ_LANE=str(k), MTFUZZ_LANES=str(len(cores)), AFL_NO_AFFINITY='1')
+            log = open('lanes/lane_' + str(k) + '.log', 'w')
+            procs.append(subprocess.Popen(['./mtfuzz'] + tmp_argvv, env=env, stdout=log, stderr=subprocess.STDOUT,
+                                          preexec_fn=lambda core=core: os.sched_setaffinity(0, [core])))
+            log.close()
+        print("%%%%%%%%%%%%% run " + self.mode + " mode on " + str(len(cores)) + " lanes")
+        self.fuzz = (procs, time.time())
+        if self.crack is not None:
+            self.pin_group(self.crack[0].pid, self.split()[1])
+
+    # pin every process of the crack stage's group: its pool workers, their
+    # manager and the targets they run
+    def pin_group(self, pgid, cores):
+        for pid in os.listdir('/proc'):
+            if not pid.isdigit():
+                continue
+            try:
+                if os.getpgid(int(pid)) == pgid:
+                    os.sched_setaffinity(int(pid), cores)
+            except (ProcessLookupError, PermissionError):
+                pass
+
+    def start_crack(self):
+        env = dict(os.environ, MTFUZZ_LANE=str(CRACK_LANE))
+        log = open('lanes/crack.log', 'w')
+        # own process group, so pin_group finds the whole stage
+        proc = subprocess.Popen([sys.executable, sys.argv[0], '--crack'] + self.argvv, env=env, stdout=log, stderr=subprocess.STDOUT,
+                                start_new_session=True, preexec_fn=lambda cores=self.split()[1]: os.sched_setaffinity(0, cores))
+        log.close()
+        print("%%%%%%%%%%%% crack hard branch")
+        self.crack = (proc, time.time())
+
+    # new edges of a lane: coverage at exit minus coverage after its dry runs
+    def lane_gain(self, k):
+        with open('lanes/lane_' + str(k) + '.log', 'r', errors='ignore') as f:
+            out = f.read()
+        dry = re.findall(r'dry run \d+ edge coverage (\d+)', out)
+        total = re.findall(r'total execs \d+ edge coverage (\d+)', out)
+        if not dry or not total:
+            return 0
+        return max(int(total[-1]) - int(dry[-1]), 0)
+
+    def poll(self):
+        procs, t0 = self.fuzz
+        if all(p.poll() is not None for p in procs):
+            self.update('fuzz', sum(self.lane_gain(k) for k in range(len(procs))), time.time() - t0)
+            self.mode = 'ctx' if self.mode == 'ec' else 'ec'
+            self.fuzz = None
+        proc, t0 = self.crack
+        if proc.poll() is not None:
+            with open('lanes/crack.log', 'r', errors='ignore') as f:
+                cracked = f.read().count('###crack branch')
+            self.update('crack', cracked, time.time() - t0)
+            self.crack = None
+
+    def run(self):
+        while True:
+            if self.fuzz is None:
+                self.start_fuzz()
+            if self.crack is None:
+                self.start_crack()
+            time.sleep(POLL_SECS)
+            self.poll()
+
 def main():
     argvv = sys.argv[1:]
-    tmp_argvv = argvv.copy()
-    while True:
-        # only save inputs that find new ec edges.
-        print("%%%%%%%%%%%%% run ec mode")
-        tmp_argvv[6] = argvv[6]+"_ec"
-        subprocess.run(['./mtfuzz']+tmp_argvv)
-        # save inputs that find new ec edges or ctx edges
-        print("%%%%%%%%%%%%% run ctx mode")
-        tmp_argvv[6] = argvv[6]+"_ctx"
-        subprocess.run(['./mtfuzz']+tmp_argvv)
-        # mutate hot bytes using intercepted operands
-        print("%%%%%%%%%%%% crack hard branch")
-        crack(tmp_argvv, argvv)
+    # one crack pass, started by the stage scheduler
+    if argvv[0] == '--crack':
+        argvv = argvv[1:]
+        crack(argvv.copy(), argvv)
+        return
+    StageScheduler(argvv).run()
 
 if __name__== "__main__":
     main()
@@ -1,6 +1,7 @@
 import pickle
 import os
-os.environ["CUDA_VISIBLE_DEVICES"]="0"
+# gradient workers run on CPU and leave the GPU to the server
+os.environ["CUDA_VISIBLE_DEVICES"]="" if os.environ.get('MTFUZZ_GRAD_WORKER') else "0"
 os.environ['TF_CPP_MIN_LOG_LEVEL'] = '3'
 import sys
 import glob
@@ -17,8 +18,7 @@ import keras.backend as K
 from collections import Counter
 set_random_seed = tf.compat.v1.set_random_seed
 from keras.models import Sequential
-from keras.layers import Input, Dense, Dropout, Activation
-from keras.callbacks import ModelCheckpoint
+from keras.layers import Input, Dense, Dropout, Activation, Concatenate, Reshape, Conv1D, GlobalMaxPooling1D
 from keras.models import Model
 from keras.utils import to_categorical
 import tensorflow as tf
@@ -50,12 +50,116 @@ alpha = []
 ec_num = 0
 soft_num = 0
 ctx_num = 0
+edge_index = None
+# representative raw edge id of each label column and its kind: 0 ec, 1 ctx, 2 approach
+col_edge = []
+col_kind = []
+# gradient failures per (kind, raw edge id), fed back by mtfuzz; ec and ctx ids overlap.
+# Counts decay by EFFICACY_FAIL_DECAY a round, so a skipped edge is tried again later
+edge_fail = {}
+EFFICACY_MAX_FAIL = 3
+EFFICACY_FAIL_DECAY = 0.8
+# weights of the last trained model, reused for heads whose label columns did not change
+prev_weights = None
+# retrain trunk and all heads from scratch every FULL_RETRAIN_INTERVAL rounds
+FULL_RETRAIN_INTERVAL = 4
+# epochs of the fine-tune when every head is restored
+FINE_TUNE_EPOCHS = 10
+TRUNK_LAYERS = ['trunk_1', 'trunk_2', 'embedding']
+# above SAMPLED_LABELS label columns, train on the positive columns of each batch
+# plus SAMPLED_NEG sampled negative columns instead of the full output layer
+SAMPLED_LABELS = 20000
+SAMPLED_NEG = 2048
+# seeds longer than CONV_INPUT_SIZE switch the first layers to strided convolutions,
+# whose size does not depend on the longest seed
+CONV_INPUT_SIZE = 10000
+# shortest input the convolutional front-end accepts
+CONV_MIN_LEN = 136
+# length of mtfuzz's loc[]/sign[] arrays and mutation buffers
+MUT_BUF_SIZE = 10000
+# unpadded length of each seed
+seed_len = []
+# number of worker processes computing gradients, 0 computes them in the server
+GRAD_WORKERS = int(os.environ.get('MTFUZZ_GRAD_WORKERS', '0'))
+# seed matrix of a gradient worker, memory mapped from grad_seed.npy
+grad_seed = None
+# train on at most CORESET_SIZE seeds chosen to cover the labels
+CORESET_SIZE = 2000
+# weight of the newest seed relative to the oldest one in the coreset choice
+CORESET_RECENCY = 2.0
+# version of the last published weight snapshot, model.mtfw links to it
+model_version = 0
+WEIGHT_MAGIC = b'MTFW'
+WEIGHT_ALIGN = 64
+# published versions kept on disk for consumers still mapping an older one
+WEIGHT_KEEP = 2
+# seed embeddings and their LSH index, for the model version they were computed with
+emb_cache = {}
+# random hyperplanes of the LSH index
+EMB_BITS = 16
+# cosine similarity above which two seeds share one gradient for the same unit
+EMB_DUP_SIM = 0.995
+# (seed hash, raw edge) -> (model version, "loc|sign") of the last gradient computed for it
+grad_cache = {}
+seed_hash = {}
+# cached gradients of the previous version are reused when the top GRAD_TOPK bytes of
+# GRAD_PROBE recomputed ones overlap by at least GRAD_REUSE_OVERLAP on average
+GRAD_PROBE = 20
+GRAD_TOPK = 64
+GRAD_REUSE_OVERLAP = 0.8
+GRAD_CACHE_SIZE = 5000
+# pre-screen gradient sweeps with the model when an exec takes more than
+# PRESCREEN_EXEC_US (avg measured by mtfuzz in exec_us): score PRESCREEN_STEPS
+# points of each (bucket, direction) sweep and keep the top PRESCREEN_KEEP of them
+PRESCREEN_EXEC_US = 10000
+PRESCREEN_STEPS = 4
+PRESCREEN_KEEP = 0.3
+# turn the pre-screen off once predicted and observed flip rates of at least
+# PRESCREEN_MIN_LINES lines differ by more than PRESCREEN_MAX_GAP
+PRESCREEN_MIN_LINES = 50
+PRESCREEN_MAX_GAP = 0.2
+prescreen_off = False
+# per byte mean and std process_data normalized the seed matrix with
+mean_var = None
+# bucket bounds of mtfuzz's num_index[], one up and one down sweep per bucket
+SWEEP_INDEX = [0, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192]
+# execs mtfuzz spent per gradient line in the last round, from gradient_efficacy
+line_execs = 0
+# fraction of seeds held out to detect a validation plateau
+VAL_SPLIT = 0.1
+# epochs without improvement of val_loss or val_accur_1 before training stops
+TRAIN_PATIENCE = 10
+# training may take TRAIN_BUDGET_RATIO of the time mtfuzz needs for one gradient
+# file at its measured exec speed, clamped to [TRAIN_MIN_SECS, TRAIN_MAX_SECS]
+TRAIN_BUDGET_RATIO = 1.0
+TRAIN_MIN_SECS = 60
+TRAIN_MAX_SECS = 3600
 from keras.backend.tensorflow_backend import set_session
 from keras.backend.tensorflow_backend import clear_session
 from keras.backend.tensorflow_backend import get_session
 
 import gc
-
+import heapq
+import multiprocessing
+import struct
+import hashlib
+
+
+# new seeds in the one order they were first listed in, kept in seed_order: lanes and
+# the crack stage number their files from separate counters, so sorting by name would
+# put a later seed before older ones and move the row ids of the label matrix
+def ordered_seeds():
+    order = []
+    if os.path.isfile('seed_order'):
+        with open('seed_order') as f:
+            order = f.read().splitlines()
+    known = set(order)
+    new = [f for f in glob.glob('./seeds/id_*') if f not in known]
+    new.sort(key=lambda f: (os.path.getmtime(f), f))
+    if new:
+        with open('seed_order', 'a') as f:
+            f.write(''.join(name + '\n' for name in new))
+    return [f for f in order if os.path.isfile(f)] + new
 
 # process training data from afl raw data
 def process_data():
@@ -68,6 +172,16 @@ def process_data():
     global ec_num
     global ctx_num
     global soft_num
+    global edge_index
+    global col_edge
+    global col_kind
+    global seed_len
+    global mean_var
+
+    # rebuild inputs that mtfuzz only logged as provenance records
+    for d in ['./vari_seeds', './seeds']:
+        if os.path.isfile(d + '/.provenance'):
+            subprocess.call(['./mtfuzz', '-R', d])
 
     # process vari seeds
     vari_seeds = glob.glob('./vari_seeds/id_*')
@@ -86,8 +200,7 @@ def process_data():
     SPLIT_RATIO = len(seed_list)
     rand_index = np.arange(SPLIT_RATIO)
     #np.random.shuffle(seed_list)
-    new_seeds = glob.glob('./seeds/id_*')
-    new_seeds.sort(key=lambda x: int(x.split('_')[3]))
+    new_seeds = ordered_seeds()
     seed_list = init_list + new_seeds
     call = subprocess.check_output
 
@@ -114,12 +227,14 @@ def process_data():
     tmp_cnt = []
     out = ''
     seed = np.zeros((len(seed_list),MAX_FILE_SIZE))
+    seed_len = []
     bitmap_list = glob.glob('./bitmaps_ec/*')
     argvv[0] = sys.argv[1] + '_ec'
     for i,f in enumerate(seed_list):
         # read a input into a matrix
         tmp = open(f,'rb').read()
         ln = len(tmp)
+        seed_len.append(ln)
         if ln < MAX_FILE_SIZE:
             tmp = tmp + (MAX_FILE_SIZE - ln) * b'\x00'
         seed[i] = np.array([j for j in list(tmp)]).astype('float32')/255
@@ -248,34 +363,60 @@ def process_data():
             # in case there is edge conflic and overwrite 1 with 0.25.
             if bitmap[seed_id][iidx] == 0:
                 bitmap[seed_id][iidx] = 0.25
-    soft_bitmap = bitmap
+
+    # edges only reached at approach level get their own soft label columns
+    approach_label = [e for e in soften_label if e not in ctx_label_dict]
+    approach_bitmap = np.zeros((len(seed_list), len(approach_label)))
+    for j, e in enumerate(approach_label):
+        approach_bitmap[soften_label[e], j] = 0.25
+    soft_bitmap = np.concatenate((bitmap, approach_bitmap), axis=1)
+    all_label = ctx_label + approach_label
 
     # delete all 1 label
     all_1_idx = np.where(np.sum(soft_bitmap==1, axis=0) == soft_bitmap.shape[0])[0]
     soft_bitmap = np.delete(soft_bitmap, all_1_idx, 1)
+    kept_idx = np.delete(np.arange(len(all_label)), all_1_idx)
+    ec_kept = int(np.sum(kept_idx < len(ec_label)))
+    ctx_kept = int(np.sum(kept_idx < len(ctx_label)))
 
-    # label dimension reduction
+    # label dimension reduction, columns are ordered ec, ctx, approach
     fit_bitmap, indices = np.unique(soft_bitmap,axis=1, return_inverse=True)
-    reconstruct_idx = list(set(indices.tolist()[:ec_bitmap.shape[1]]))
+    reconstruct_idx = list(set(indices.tolist()[:ec_kept]))
     ec_num = len(reconstruct_idx)
-    reconstruct_idx = reconstruct_idx + list(set(indices.tolist()[ec_bitmap.shape[1]:ctx_bitmap.shape[1]]) - set(reconstruct_idx))
+    reconstruct_idx = reconstruct_idx + list(set(indices.tolist()[ec_kept:ctx_kept]) - set(reconstruct_idx))
     ctx_num = len(reconstruct_idx) - ec_num
-    soft_num = 0
+    reconstruct_idx = reconstruct_idx + list(set(indices.tolist()[ctx_kept:]) - set(reconstruct_idx))
+    soft_num = len(reconstruct_idx) - ec_num - ctx_num
     print(fit_bitmap[:, np.asarray(reconstruct_idx)].shape, ec_num, ctx_num, soft_num)
 
     fit_bitmap = fit_bitmap[:, np.asarray(reconstruct_idx)]
+    # keep one raw edge id per deduplicated column to identify gradient targets in mtfuzz
+    rep = {}
+    for i, u in enumerate(indices.tolist()):
+        if u not in rep:
+            rep[u] = int(kept_idx[i])
+    col_edge = [all_label[rep[u]] for u in reconstruct_idx]
+    col_kind = [0 if rep[u] < len(ec_label) else (1 if rep[u] < len(ctx_label) else 2) for u in reconstruct_idx]
     print("#####data dimension############# " + str(fit_bitmap.shape))
     MAX_BITMAP_SIZE = fit_bitmap.shape[1]
     # select new edges
     if round_cnt >= 1:
         old_fitmap = np.load("prior_bitmap.npy")
         fit_bitmap_partial = fit_bitmap[:old_fitmap.shape[0]]
-        new_edges=np.where(np.sum(fit_bitmap_partial,axis=0)==0)[0].tolist()
+        # approach level columns have no seed covering them, they are not mutation targets
+        new_edges=np.where(np.sum(fit_bitmap_partial[:, :ec_num + ctx_num],axis=0)==0)[0].tolist()
         print("####new_edge num################# : "+ str(len(new_edges)))
     else:
         new_edges = []
     np.save("prior_bitmap", fit_bitmap)
 
+    # index label columns for rare edge selection; while the column layout holds,
+    # only the rows of new seeds are appended
+    if edge_index is None or edge_index.col_edge != col_edge or edge_index.row_num > fit_bitmap.shape[0]:
+        edge_index = EdgeIndex(MAX_BITMAP_SIZE)
+        edge_index.col_edge = col_edge
+    edge_index.append_rows(fit_bitmap[edge_index.row_num:])
+
 
     # normalize seed
     mean_var = np.zeros((2,MAX_FILE_SIZE))
@@ -287,6 +428,115 @@ def process_data():
     return seed,fit_bitmap
 
 
+# edge->seed inverted index (CSR) with per-edge hit counters, so rare edge and seed
+# selection do not rescan the label matrix.
+class EdgeIndex(object):
+    def __init__(self, edge_num):
+        self.edge_num = edge_num
+        self.row_num = 0
+        # raw edge of each column, the index is only valid for this layout
+        self.col_edge = None
+        # seeds hitting edge e are indices[indptr[e]:indptr[e+1]] plus pending[e]
+        self.indptr = np.zeros(edge_num + 1, dtype=np.int64)
+        self.indices = np.zeros(0, dtype=np.int64)
+        self.pending = {}
+        # hits counts label 1 only, soft_hits also counts 0.25 soft labels
+        self.hits = np.zeros(edge_num, dtype=np.int64)
+        self.soft_hits = np.zeros(edge_num)
+
+    def append_rows(self, rows):
+        rows = np.atleast_2d(rows)
+        if rows.shape[0] == 0:
+            return
+        seed_idx, edge_idx = np.nonzero(rows == 1)
+        self.hits += np.bincount(edge_idx, minlength=self.edge_num)
+        self.soft_hits += np.sum(rows, axis=0)
+        if self.row_num == 0:
+            order = np.argsort(edge_idx, kind='stable')
+            self.indices = seed_idx[order]
+            self.indptr[1:] = np.cumsum(np.bincount(edge_idx, minlength=self.edge_num))
+        else:
+            for e, s in zip(edge_idx.tolist(), (seed_idx + self.row_num).tolist()):
+                self.pending.setdefault(e, []).append(s)
+        self.row_num += rows.shape[0]
+
+    def seeds_of(self, edge):
+        one_idx = self.indices[self.indptr[edge]:self.indptr[edge + 1]]
+        if edge in self.pending:
+            one_idx = np.concatenate((one_idx, self.pending[edge]))
+        return one_idx
+
+    # k rarest edges in [lo, hi), ties broken by edge index
+    def rarest(self, k, lo, hi, soft=False, skip=()):
+        count = (self.soft_hits if soft else self.hits).tolist()
+        cand = (e for e in range(lo, hi) if e not in skip)
+        return heapq.nsmallest(k, cand, key=lambda e: (count[e], e))
+
+
+# random projection LSH over seed embeddings: seeds with the same code are close,
+# cosine similarity inside a bucket separates near-duplicates.
+class LSHIndex(object):
+    def __init__(self, emb, bits):
+        center = emb - np.mean(emb, axis=0)
+        planes = np.random.RandomState(bits).randn(emb.shape[1], bits)
+        self.codes = np.dot((np.dot(center, planes) > 0).astype(np.int64), 1 << np.arange(bits, dtype=np.int64))
+        self.unit = emb / (np.linalg.norm(emb, axis=1, keepdims=True) + 1e-8)
+        self.buckets = {}
+        for r, code in enumerate(self.codes):
+            self.buckets.setdefault(code, []).append(r)
+
+    def similar(self, a, b, sim):
+        return self.codes[a] == self.codes[b] and np.dot(self.unit[a], self.unit[b]) >= sim
+
+
+# embeddings of all seeds under the current model version, computed in one batched pass
+def embedding_index(model, seed):
+    if model_version in emb_cache and emb_cache[model_version][0].shape[0] == seed.shape[0]:
+        return emb_cache[model_version][1]
+    t0 = time.time()
+    emb = K.function([model.input], [model.get_layer('embedding_act').output])
+    out = np.concatenate([emb([seed[i:i + 256]])[0] for i in range(0, seed.shape[0], 256)])
+    emb_cache.clear()
+    emb_cache[model_version] = (out, LSHIndex(out, EMB_BITS))
+    print("### embedded " + str(out.shape[0]) + " seeds in " + str(time.time() - t0) + ", " + str(len(emb_cache[model_version][1].buckets)) + " buckets")
+    return emb_cache[model_version][1]
+
+
+# Stop training on a validation plateau (falls back to the training loss without a
+# held-out split) or when the round's time budget is used up, and say why.
+class TrainBudget(keras.callbacks.Callback):
+    def __init__(self, budget):
+        self.budget = budget
+        self.t0 = time.time()
+        self.best = {}
+        self.wait = 0
+
+    def on_epoch_end(self, epoch, logs={}):
+        monitors = [('val_loss', -1), ('val_accur_1', 1)] if 'val_loss' in logs else [('loss', -1)]
+        improved = False
+        for key, direction in monitors:
+            if key in logs and (key not in self.best or direction * (logs[key] - self.best[key]) > 0):
+                self.best[key] = logs[key]
+                improved = True
+        self.wait = 0 if improved else self.wait + 1
+        if self.wait >= TRAIN_PATIENCE:
+            print("### training stopped at epoch " + str(epoch + 1) + ": no improvement for " + str(TRAIN_PATIENCE) + " epochs")
+            self.model.stop_training = True
+        elif time.time() - self.t0 > self.budget:
+            print("### training stopped at epoch " + str(epoch + 1) + ": time budget " + str(int(self.budget)) + "s used up")
+            self.model.stop_training = True
+
+
+# seconds mtfuzz needs to run one gradient file at its measured exec speed
+def train_budget(edge_num):
+    if line_execs == 0 or not os.path.isfile('exec_us'):
+        return TRAIN_MAX_SECS
+    with open('exec_us') as f:
+        exec_us = float(f.read())
+    fuzz_secs = edge_num * line_execs * exec_us / 1e6
+    return min(max(TRAIN_BUDGET_RATIO * fuzz_secs, TRAIN_MIN_SECS), TRAIN_MAX_SECS)
+
+
 # learning rate decay
 def step_decay(epoch):
     initial_lrate = 0.001
@@ -343,26 +593,223 @@ def weighted_cross_entropy(y_true, y_pred):
 
     return tf.reduce_mean(loss)
 
+# loss of the sampled training model, y_true packs [labels | beta | alpha] of the sampled columns
+def sampled_cross_entropy(y_true, y_pred):
+    n = tf.shape(y_pred)[1]
+    y_pred = tf.clip_by_value(y_pred, tf.keras.backend.epsilon(), 1 - tf.keras.backend.epsilon())
+    logits = tf.log(y_pred / (1 - y_pred))
+    loss = tf.nn.weighted_cross_entropy_with_logits(logits=logits, targets=y_true[:, :n], pos_weight=y_true[:, n:2*n])
+    return tf.reduce_mean(y_true[:, 2*n:] * loss)
+
+
+# Output of the heads restricted to the label columns in cols. Shares kernel and bias
+# with the exact head layers, so training through it updates the exact model.
+class SampledHeads(keras.layers.Layer):
+    def __init__(self, heads, **kwargs):
+        self.heads = heads
+        super(SampledHeads, self).__init__(**kwargs)
+
+    def build(self, input_shape):
+        self._trainable_weights = [w for layer, lo in self.heads if layer.trainable for w in layer.trainable_weights]
+        super(SampledHeads, self).build(input_shape)
+
+    def call(self, inputs):
+        emb, cols = inputs
+        cols = K.cast(cols[0], 'int32')
+        logits = 0
+        for layer, lo in self.heads:
+            width = layer.units
+            idx = K.clip(cols - lo, 0, width - 1)
+            out = K.dot(emb, tf.gather(layer.kernel, idx, axis=1)) + tf.gather(layer.bias, idx)
+            mask = K.cast(tf.logical_and(cols >= lo, cols < lo + width), 'float32')
+            logits = logits + out * mask
+        return K.sigmoid(logits)
+
+    def compute_output_shape(self, input_shape):
+        return (input_shape[0][0], input_shape[1][1])
+
+
+# batches of (seed, sampled columns) -> packed targets. Every column that is set in
+# the batch is kept, negatives are sampled and up-weighted by their sampling rate.
+def sampled_batches(seed, label, batch_size):
+    while True:
+        rows = np.random.randint(0, seed.shape[0], batch_size)
+        y = label[rows]
+        pos = np.where(np.any(y > 0, axis=0))[0]
+        rest = np.setdiff1d(np.arange(MAX_BITMAP_SIZE), pos, assume_unique=True)
+        neg = np.random.choice(rest, min(SAMPLED_NEG, rest.shape[0]), replace=False)
+        cols = np.concatenate((pos, neg))
+        w = np.ones(cols.shape[0])
+        if neg.shape[0] > 0:
+            w[pos.shape[0]:] = float(rest.shape[0]) / neg.shape[0]
+        target = np.concatenate((y[:, cols], np.tile(beta[cols], (batch_size, 1)), np.tile(alpha[cols] * w, (batch_size, 1))), axis=1)
+        yield [seed[rows], np.tile(cols, (batch_size, 1))], target
+
+
+# keep the weights of the epoch with the lowest loss in memory and restore them
+# when training ends. exact is the model whose weights are tracked.
+class BestWeights(keras.callbacks.Callback):
+    def __init__(self, exact):
+        self.exact = exact
+        self.best = np.inf
+        self.weights = None
+
+    def on_epoch_end(self, epoch, logs={}):
+        loss = logs.get('val_loss', logs.get('loss'))
+        if loss < self.best:
+            self.best = loss
+            self.weights = self.exact.get_weights()
+
+    def on_train_end(self, logs={}):
+        if self.weights is not None:
+            self.exact.set_weights(self.weights)
+
+
+def weight_file(version):
+    return 'model_' + str(version) + '.mtfw'
+
+
+# Snapshot layout, little endian: magic, version, array count, then per array its
+# dimension count, dimensions and data offset. Data is float32, WEIGHT_ALIGN aligned.
+# The snapshot is written to a temporary file and renamed, then model.mtfw is
+# switched to it, so a reader never sees a partial model.
+def publish_weights(model):
+    global model_version
+    model_version += 1
+    arrays = [w.astype('<f4') for w in model.get_weights()]
+    header = WEIGHT_MAGIC + struct.pack('<II', model_version, len(arrays))
+    size = len(header) + sum(4 + 4 * w.ndim + 8 for w in arrays)
+    offsets = []
+    for w in arrays:
+        size = (size + WEIGHT_ALIGN - 1) // WEIGHT_ALIGN * WEIGHT_ALIGN
+        offsets.append(size)
+        size += w.nbytes
+    for w, off in zip(arrays, offsets):
+        header += struct.pack('<I', w.ndim) + struct.pack('<' + 'I' * w.ndim, *w.shape) + struct.pack('<Q', off)
+
+    name = weight_file(model_version)
+    with open(name + '.tmp', 'wb') as f:
+        f.write(header)
+        for w, off in zip(arrays, offsets):
+            f.write(b'\x00' * (off - f.tell()))
+            f.write(w.tobytes())
+    os.rename(name + '.tmp', name)
+    if os.path.lexists('model.mtfw.tmp'):
+        os.remove('model.mtfw.tmp')
+    os.symlink(name, 'model.mtfw.tmp')
+    os.rename('model.mtfw.tmp', 'model.mtfw')
+    old = weight_file(model_version - WEIGHT_KEEP)
+    if os.path.isfile(old):
+        os.remove(old)
+    print("### published model version " + str(model_version))
+
+
+# map the arrays of a weight snapshot without copying them
+def map_weights(path):
+    with open(path, 'rb') as f:
+        head = f.read(12)
+        if head[:4] != WEIGHT_MAGIC:
+            raise ValueError(path + ' is not a weight snapshot')
+        version, num = struct.unpack('<II', head[4:])
+        arrays = []
+        for i in range(num):
+            ndim = struct.unpack('<I', f.read(4))[0]
+            shape = struct.unpack('<' + 'I' * ndim, f.read(4 * ndim))
+            off = struct.unpack('<Q', f.read(8))[0]
+            arrays.append(np.memmap(path, dtype='<f4', mode='r', offset=off, shape=shape))
+    return version, arrays
+
+
+def train_sampled(model, seed, label, epochs=100):
+    print("build sampled model for " + str(MAX_BITMAP_SIZE) + " label columns")
+    cols = Input(shape=(None,), dtype='int32')
+    heads = [(model.get_layer(name), lo) for name, lo, hi in head_ranges() if hi > lo]
+    out = SampledHeads(heads)([model.get_layer('embedding_act').output, cols])
+    sampled = Model(inputs=[model.input, cols], outputs=out)
+    sampled.compile(loss=sampled_cross_entropy, optimizer=keras.optimizers.adam(lr=0.0001))
+
+    loss_history = LossHistory()
+    lrate = keras.callbacks.LearningRateScheduler(step_decay)
+    callbacks_list = [loss_history, lrate, BestWeights(model), TrainBudget(train_budget(750))]
+    batch_size = max(32, int(seed.shape[0]/50))
+    sampled.fit_generator(sampled_batches(seed, label, batch_size),
+                    steps_per_epoch=50,
+                    epochs=epochs,
+                    verbose=1, callbacks=callbacks_list)
+
+# embedding unit with the largest weight into label column f, random unit if f has no head
+def edge_unit(model, f):
+    for name, lo, hi in head_ranges():
+        if lo <= f < hi:
+            kernel = model.get_layer(name).get_weights()[0]
+            return int(np.argmax(np.absolute(kernel[:, f - lo])))
+    return np.random.randint(512)
+
 def gen_adv4(f, fl, model, layer_list, idxx, splice, seed):
     adv_list = []
-    #loss = layer_list[-2][1].output[:, f]
-    loss = layer_list[4][1].output[:,np.random.randint(512)]
-    #loss = layer_list[3][1].output
+    # gradient of the shared embedding unit that drives the target edge most
+    loss = model.get_layer('embedding').output[:, edge_unit(model, f)]
     grads = K.gradients(loss, model.input)[0]
     iterate = K.function([model.input], [loss, grads])
     ll = len(fl)
 
     for index in range(ll):
-        x = seed[fl[index]].reshape((1,seed.shape[1]))
+        x = seed[fl[index]]
+        # the convolutional front-end takes the seed at its own length instead of padded
+        if use_conv():
+            x = x[:max(seed_len[fl[index]], CONV_MIN_LEN)]
+        x = x.reshape((1,x.shape[0]))
         loss_value, grads_value = iterate([x])
-        idx = np.flip(np.argsort(np.absolute(grads_value), axis=1)[:, -MAX_FILE_SIZE:].reshape((MAX_FILE_SIZE,)), 0)
+        idx = np.flip(np.argsort(np.absolute(grads_value[0])), 0)
+        # mtfuzz can only mutate offsets inside its buffers
+        idx = idx[idx < MUT_BUF_SIZE]
         val = np.sign(grads_value[0][idx])
         adv_list.append((idx, val, seed_list[fl[index]]))
     return adv_list
 
+# consume efficacy records written by mtfuzz, one per gradient line:
+# column raw_edge kind flipped execs new_edges
+def load_efficacy():
+    global prescreen_off
+    global line_execs
+    if not os.path.isfile('gradient_efficacy'):
+        return
+    os.rename('gradient_efficacy', 'gradient_efficacy.old')
+    for key in edge_fail:
+        edge_fail[key] *= EFFICACY_FAIL_DECAY
+    total = 0
+    flip_cnt = 0
+    execs = 0
+    preds = []
+    flips = []
+    with open('gradient_efficacy.old') as f:
+        for line in f:
+            tok = line.split()
+            if len(tok) < 6 or int(tok[3]) < 0:
+                continue
+            key = (int(tok[2]), int(tok[1]))
+            if len(tok) > 6 and float(tok[6]) >= 0:
+                preds.append(float(tok[6]))
+                flips.append(int(tok[3]))
+            total += 1
+            execs += int(tok[4])
+            if int(tok[3]) == 1 or int(tok[5]) > 0:
+                flip_cnt += int(tok[3])
+                edge_fail[key] = 0
+            else:
+                edge_fail[key] = edge_fail.get(key, 0) + 1
+    if total > 0:
+        line_execs = execs // total
+        print("### gradient efficacy: " + str(flip_cnt) + "/" + str(total) + " target edges flipped, " + str(line_execs) + " execs per line")
+    if len(preds) >= PRESCREEN_MIN_LINES:
+        pred, obs = np.mean(preds), np.mean(flips)
+        print("### prescreen predicted flip rate " + str(round(pred, 4)) + " observed " + str(round(obs, 4)))
+        if abs(pred - obs) > PRESCREEN_MAX_GAP:
+            prescreen_off = True
+            print("### prescreen miscalibrated, turn it off")
+
 # grenerate gradient information to guide furture muatation
 def gen_mutate3(model, edge_num, sign, seed, label, weighted):
-    tmp_list = []
     # select seeds
     rand_seed1 = []
     rand_seed2 = []
@@ -376,62 +823,299 @@ def gen_mutate3(model, edge_num, sign, seed, label, weighted):
     else:
         # select rare edges
         if(edge_num > len(new_edges)):
-            interested_indice = new_edges
+            interested_indice = list(new_edges)
+            # skip edges whose gradients repeatedly failed to flip them
+            failing = [i for i, e in enumerate(col_edge) if edge_fail.get((col_kind[i], e), 0) >= EFFICACY_MAX_FAIL]
+            print("### skip " + str(len(failing)) + " edges with failing gradients")
+            skip = set(new_edges) | set(failing)
+            need = edge_num - len(interested_indice)
 
             if (round_cnt%2) == 1:
-                rare_label = label[:,ec_num:ctx_num]
-                rare_edge_list = [ele+ec_num for ele in np.argsort(np.sum(rare_label, axis=0)).tolist()]
-                rare_label = label[:, :ec_num]
-                rare_label = np.where(rare_label==0.25, 0, rare_label)
-                rare_edge_list = rare_edge_list + np.argsort(np.sum(rare_label, axis=0)).tolist()
-
+                rare_edge_list = edge_index.rarest(need, ec_num, ec_num + ctx_num, soft=True, skip=skip)
+                rare_edge_list = rare_edge_list + edge_index.rarest(need - len(rare_edge_list), 0, ec_num, skip=skip)
             else:
-                rare_label = label[:,:ec_num]
-                rare_label = np.where(rare_label==0.25, 0, rare_label)
-                rare_edge_list = np.argsort(np.sum(rare_label, axis=0)).tolist()
-
-            for rare_edge in rare_edge_list:
-                if rare_edge in new_edges:
-                    continue
-                else:
-                    interested_indice.append(rare_edge)
-                if len(interested_indice) == edge_num:
-                    break
+                rare_edge_list = edge_index.rarest(need, 0, ec_num, skip=skip)
+            interested_indice = interested_indice + rare_edge_list
         else:
             interested_indice = new_edges[:edge_num]
 
-        # select inputs
+        # select inputs, preferring seeds from embedding buckets not picked yet
+        emb_index = embedding_index(model, seed)
+        used = set()
         for edge in interested_indice:
-            one_idx = np.where(label[:,edge]==1)[0]
-            tmp_rand = np.random.choice(one_idx,1, replace=False)[0]
+            one_idx = edge_index.seeds_of(edge)
+            fresh = [r for r in one_idx if emb_index.codes[r] not in used]
+            tmp_rand = np.random.choice(fresh if fresh else one_idx,1, replace=False)[0]
+            used.add(emb_index.codes[tmp_rand])
             rand_seed1.append(tmp_rand)
 
     print("### rare edge selection: " + str(weighted))
 
-    fn = gen_adv4
-    layer_list = [(layer.name, layer) for layer in model.layers]
+    pairs = [(int(interested_indice[i]), rand_seed1[i]) for i in range(len(interested_indice))]
+    pairs, reused = reuse_grads(pairs, seed, label)
+    pairs, alias = dedup_pairs(model, seed, pairs)
+    lines = run_grads(pairs, seed, label)
+    # near-duplicate seeds reuse the loc/sign of the seed computed for the same unit
+    for (index, seed_idx), rep in alias:
+        tok = lines[rep].split('|')
+        lines.append('|'.join(tok[:2] + [seed_list[seed_idx], str(index), str(col_edge[index]), str(col_kind[index])]) + "\n")
+    cache_grads(lines)
+    lines = lines + reused
+    if prescreen_enabled():
+        lines = prescreen(model, lines)
+    with open('gradient_info_p', 'w') as f:
+        f.writelines(lines)
+
+
+def prescreen_enabled():
+    if prescreen_off or not os.path.isfile('exec_us'):
+        return False
+    with open('exec_us') as f:
+        return float(f.read()) > PRESCREEN_EXEC_US
+
+
+# Score the sweeps of each gradient line with one batched forward pass over points
+# along them. Points are built from the raw seed bytes and normalized like the
+# training seeds; a point flips the target column when its output crosses 0.5
+# from the side of the unmutated seed. Appends the keep mask (one char per bucket
+# and direction, up first) and the predicted flip probability of the kept sweeps.
+def prescreen(model, lines):
+    std = np.where(mean_var[1] != 0, mean_var[1], 1)
+    out = []
+    kept = 0
+    total = 0
+    for line in lines:
+        tok = line.rstrip('\n').split('|')
+        loc = np.array(tok[0].split(','), dtype=int)
+        sgn = np.array(tok[1].split(','), dtype=int)
+        col = int(tok[3])
+        tmp = open(tok[2], 'rb').read()[:MAX_FILE_SIZE]
+        base = np.zeros(MAX_FILE_SIZE)
+        base[:len(tmp)] = list(tmp)
+        cands = [base]
+        keys = [-1]
+        for it in range(len(SWEEP_INDEX) - 1):
+            lo, hi = SWEEP_INDEX[it], min(SWEEP_INDEX[it + 1], loc.shape[0])
+            if lo >= hi:
+                break
+            l, sg, b = loc[lo:hi], sgn[lo:hi], base[loc[lo:hi]]
+            up = np.max(np.where(sg == 1, 255 - b, b))
+            low = np.max(np.where(sg == 1, b, 255 - b))
+            for d, steps, direction in ((0, up, 1), (1, low, -1)):
+                for k in range(1, PRESCREEN_STEPS + 1):
+                    t = int(math.ceil(k * steps / float(PRESCREEN_STEPS)))
+                    if t == 0:
+                        continue
+                    x = base.copy()
+                    x[l] = np.clip(b + direction * sg * t, 0, 255)
+                    cands.append(x)
+                    keys.append(it * 2 + d)
+        pred = model.predict((np.array(cands) / 255 - mean_var[0]) / std, batch_size=256)[:, col]
+        flip = pred[1:] if pred[0] < 0.5 else 1 - pred[1:]
+        score = {}
+        for key, p in zip(keys[1:], flip):
+            score[key] = max(score.get(key, 0), p)
+        top = sorted(score, key=lambda key: -score[key])[:int(math.ceil(PRESCREEN_KEEP * len(score)))]
+        mask = ''.join('1' if key in top else '0' for key in range(2 * (len(SWEEP_INDEX) - 1)))
+        line_pred = max([score[key] for key in top]) if top else 0
+        kept += len(top)
+        total += len(score)
+        out.append('|'.join(tok[:6] + [mask, str(round(float(line_pred), 4))]) + '\n')
+    print("### prescreen keeps " + str(kept) + " of " + str(total) + " sweeps")
+    return out
+
+
+def run_grads(pairs, seed, label):
+    if GRAD_WORKERS > 0:
+        return farm_grads(pairs, seed)
+    return compute_grads(pairs, seed, label)
+
+
+def grad_key(path, index):
+    if path not in seed_hash:
+        seed_hash[path] = hashlib.md5(open(path, 'rb').read()).hexdigest()
+    return (seed_hash[path], col_edge[index])
+
+
+def cache_grads(lines):
+    for line in lines:
+        tok = line.split('|')
+        grad_cache[grad_key(tok[2], int(tok[3]))] = (model_version, '|'.join(tok[:2]))
+    if len(grad_cache) > GRAD_CACHE_SIZE:
+        keep = sorted(grad_cache.items(), key=lambda x: x[1][0])[-GRAD_CACHE_SIZE:]
+        grad_cache.clear()
+        grad_cache.update(keep)
+
+
+# Reuse gradients cached under the previous model version if the model barely moved.
+# A probe of cached pairs is recomputed, and the overlap of their top GRAD_TOPK bytes
+# with the cached ones decides. Returns the pairs still to compute and the finished
+# lines, which include the probes.
+def reuse_grads(pairs, seed, label):
+    hit = []
+    todo = []
+    for pair in pairs:
+        entry = grad_cache.get(grad_key(seed_list[pair[1]], pair[0]))
+        if entry is not None and entry[0] == model_version - 1:
+            hit.append((pair, entry[1]))
+        else:
+            todo.append(pair)
+    if not hit:
+        return pairs, []
+
+    probed = set(np.random.permutation(len(hit))[:GRAD_PROBE].tolist())
+    probe = [hit[i] for i in sorted(probed)]
+    probe_lines = run_grads([pair for pair, old in probe], seed, label)
+    overlap = []
+    for (pair, old), line in zip(probe, probe_lines):
+        old_top = set(old.split('|')[0].split(',')[:GRAD_TOPK])
+        new_top = line.split('|')[0].split(',')[:GRAD_TOPK]
+        overlap.append(len(old_top.intersection(new_top)) / float(max(len(new_top), 1)))
+    drift = 1 - np.mean(overlap)
+    print("### gradient drift " + str(round(drift, 4)) + " on " + str(len(probe)) + " probes")
+    cache_grads(probe_lines)
+    rest = [hit[i] for i in range(len(hit)) if i not in probed]
+    if drift > 1 - GRAD_REUSE_OVERLAP:
+        return todo + [pair for pair, old in rest], probe_lines
+
+    lines = []
+    for (index, seed_idx), old in rest:
+        grad_cache[grad_key(seed_list[seed_idx], index)] = (model_version, old)
+        lines.append(old + '|' + seed_list[seed_idx] + '|' + str(index) + '|' + str(col_edge[index]) + '|' + str(col_kind[index]) + "\n")
+    print("### reuse " + str(len(lines)) + " cached gradients")
+    return todo, probe_lines + lines
+
+
+# gradients follow one embedding unit per column, so pairs whose columns share a unit
+# and whose seeds are near-duplicates in embedding space get the same loc/sign.
+# Returns the pairs to compute and (pair, position of its representative) for the rest.
+def dedup_pairs(model, seed, pairs):
+    emb_index = embedding_index(model, seed)
+    units = {}
+    reps = {}
+    todo = []
+    alias = []
+    for index_col, seed_idx in pairs:
+        if index_col not in units:
+            units[index_col] = edge_unit(model, index_col)
+        group = reps.setdefault(units[index_col], [])
+        rep = [pos for pos in group if emb_index.similar(todo[pos][1], seed_idx, EMB_DUP_SIM)]
+        if rep:
+            alias.append(((index_col, seed_idx), rep[0]))
+        else:
+            group.append(len(todo))
+            todo.append((index_col, seed_idx))
+    if alias:
+        print("### " + str(len(alias)) + " near-duplicate seeds reuse gradients")
+    return todo, alias
+
 
+# gradient lines for (label column, seed index) pairs from the published model version
+def compute_grads(pairs, seed, label):
+    lines = []
+    t0 = time.time()
+    for idxx, (index, seed_idx) in enumerate(pairs):
+        # kears's would stall after multiple gradient compuation. Release memory and reload model to fix it.
+        if (idxx % 100 == 0):
+            clear_session()
+            model = build_model(label, True)
+            model.set_weights(map_weights(weight_file(model_version))[1])
+            layer_list = [(layer.name, layer) for layer in model.layers]
+            print("number of feature " + str(idxx) + " " + str(time.time()-t0))
+        adv_list = gen_adv4(index, [seed_idx], model, layer_list, idxx, 0, seed)
+        for ele in adv_list:
+            ele0 = [str(el) for el in ele[0]]
+            ele1 = [str(int(el)) for el in ele[1]]
+            ele2 = ele[2]
+            lines.append(",".join(ele0) + '|' + ",".join(ele1) + '|' + ele2 + '|' + str(index) + '|' + str(col_edge[index]) + '|' + str(col_kind[index]) + "\n")
+    return lines
+
+
+def grad_worker_init(state):
+    global grad_seed
+    globals().update(state)
+    grad_seed = np.load('grad_seed.npy', mmap_mode='r')
+
+
+def grad_worker(pairs):
+    return compute_grads(pairs, grad_seed, None)
+
+
+# split the pairs into contiguous shards and compute them in GRAD_WORKERS processes.
+# Workers map the published weights and share the seed matrix through a memory mapped file.
+def farm_grads(pairs, seed):
+    # every pair was served from the gradient cache
+    if not pairs:
+        return []
+    np.save('grad_seed.npy', seed)
+    state = {'MAX_FILE_SIZE': MAX_FILE_SIZE, 'MAX_BITMAP_SIZE': MAX_BITMAP_SIZE, 'ec_num': ec_num, 'ctx_num': ctx_num,
+             'soft_num': soft_num, 'col_edge': col_edge, 'col_kind': col_kind, 'seed_list': seed_list, 'seed_len': seed_len,
+             'model_version': model_version}
+    shard = int(math.ceil(len(pairs) / float(GRAD_WORKERS)))
+    shards = [pairs[i:i + shard] for i in range(0, len(pairs), shard)]
+    t0 = time.time()
+    os.environ['MTFUZZ_GRAD_WORKER'] = '1'
+    try:
+        with multiprocessing.get_context('spawn').Pool(len(shards), initializer=grad_worker_init, initargs=(state,)) as pool:
+            results = pool.map(grad_worker, shards)
+    finally:
+        del os.environ['MTFUZZ_GRAD_WORKER']
+    print("### " + str(len(pairs)) + " gradients from " + str(len(shards)) + " workers in " + str(time.time() - t0))
+    return [line for lines in results for line in lines]
+
+
+# heuristic gradient used before the first model is ready: order bytes by their
+# variance across seeds and push each byte toward the per-byte mean.
+def gen_bootstrap_grad(edge_num):
+    seeds = glob.glob('./seeds/id:*')
+    seeds.sort()
+    seeds = seeds + ordered_seeds()
+    raw = [open(f, 'rb').read() for f in seeds]
+    file_size = max([len(tmp) for tmp in raw])
+    data = np.zeros((len(raw), file_size))
+    for i, tmp in enumerate(raw):
+        data[i, :len(tmp)] = np.frombuffer(tmp, dtype=np.uint8)
+    data = data / 255
+    mean_var = np.zeros((2, file_size))
+    mean_var[0] = np.mean(data, axis=0)
+    mean_var[1] = np.std(data, axis=0)
+    idx = np.argsort(-mean_var[1], kind='stable')
+    idx = idx[idx < MUT_BUF_SIZE]
+
+    fl = np.random.permutation(len(seeds))[:edge_num]
     with open('gradient_info_p', 'w') as f:
-        t0 = time.time()
-        for idxx in range(len(interested_indice[:])):
-            # kears's would stall after multiple gradient compuation. Release memory and reload model to fix it.
-            if (idxx % 100 == 0):
-                clear_session()
-                model = build_model(label, True)
-                model.load_weights('model.h5')
-                layer_list = [(layer.name, layer) for layer in model.layers]
-                print("number of feature " + str(idxx) + " " + str(time.time()-t0))
-            index = int(interested_indice[idxx])
-            fl = [rand_seed1[idxx]]
-            adv_list = fn(index, fl, model, layer_list, idxx, 0, seed)
-            tmp_list.append(adv_list)
-            for ele in adv_list:
-                ele0 = [str(el) for el in ele[0]]
-                ele1 = [str(int(el)) for el in ele[1]]
-                ele2 = ele[2]
-                f.write(",".join(ele0) + '|' + ",".join(ele1) + '|' + ele2 + "\n")
+        for i in fl:
+            val = np.sign(mean_var[0][idx] - data[i][idx])
+            val[val == 0] = 1
+            f.write(",".join([str(el) for el in idx]) + '|' + ",".join([str(int(el)) for el in val]) + '|' + seeds[i] + "\n")
+    print("### bootstrap gradient from " + str(len(fl)) + " seeds")
+
+
+def use_conv():
+    return MAX_FILE_SIZE > CONV_INPUT_SIZE
+
+
+# weights of the first layers only fit models with the same front-end
+def front_end():
+    return 'conv' if use_conv() else MAX_FILE_SIZE
+
+
+# label columns predicted by each head
+def head_ranges():
+    return [('ec_head', 0, ec_num), ('ctx_head', ec_num, ec_num + ctx_num), ('approach_head', ec_num + ctx_num, ec_num + ctx_num + soft_num)]
 
 
+def compile_model(model, weighted_loss):
+    opt = keras.optimizers.adam(lr=0.0001)
+    if weighted_loss:
+        print("build weighted_loss model")
+        model.compile(loss=weighted_cross_entropy, optimizer=opt, metrics=[accur_1])
+    else:
+        model.compile(loss='binary_crossentropy', optimizer=opt, metrics=[accur_1])
+
+
+# shared trunk ending in a 512 unit embedding, one sigmoid head per coverage task.
+# Heads are concatenated so the model output still matches the label columns.
 def build_model(data, weighted_loss):
     global beta
     global alpha
@@ -439,58 +1123,181 @@ def build_model(data, weighted_loss):
     num_classes = MAX_BITMAP_SIZE
     epochs = 50
 
-    model = Sequential()
-    model.add(Dense(2048, input_dim=MAX_FILE_SIZE))
-    model.add(Activation('relu'))
-    model.add(Dense(1024))
-    model.add(Activation('relu'))
-    model.add(Dense(512))
-    model.add(Activation('relu'))
-    model.add(Dense(num_classes))
-    model.add(Activation('sigmoid'))
+    if use_conv():
+        # per-byte gradients still come back through the convolutions
+        inp = Input(shape=(None,))
+        x = Reshape((-1, 1))(inp)
+        x = Conv1D(64, 16, strides=8, activation='relu', name='trunk_1')(x)
+        x = Conv1D(128, 16, strides=8, activation='relu', name='trunk_2')(x)
+        x = GlobalMaxPooling1D()(x)
+    else:
+        inp = Input(shape=(MAX_FILE_SIZE,))
+        x = Dense(2048, name='trunk_1')(inp)
+        x = Activation('relu')(x)
+        x = Dense(1024, name='trunk_2')(x)
+        x = Activation('relu')(x)
+    x = Dense(512, name='embedding')(x)
+    x = Activation('relu', name='embedding_act')(x)
+    heads = [Dense(hi - lo, activation='sigmoid', name=name)(x) for name, lo, hi in head_ranges() if hi > lo]
+    out = heads[0] if len(heads) == 1 else Concatenate()(heads)
+    model = Model(inputs=inp, outputs=out)
+    # gradient workers only run the model forward and backward to the input
+    if data is None:
+        return model
 
-    opt = keras.optimizers.adam(lr=0.0001)
     pos_weight = (np.sum(data==0, axis=0)+ np.sum(data==0.25, axis=0)/4) / (np.sum(data==1, axis=0)+0.75*np.sum(data==0.25, axis=0))
     # pos_weight = ((data.shape[0] - np.sum(data,axis=0))/np.sum(data, axis=0))
     beta = pos_weight
     alpha = (1 + 1/beta)/2
     # loss = partial(weighted_cross_entropy, beta=pos_weight)
     model.summary()
-    if weighted_loss:
-        print("build weighted_loss model")
-        model.compile(loss=weighted_cross_entropy, optimizer=opt, metrics=[accur_1])
-    else:
-        model.compile(loss='binary_crossentropy', optimizer=opt, metrics=[accur_1])
+    compile_model(model, weighted_loss)
 
     return model
 
 
+# restore trunk and heads of the previous round whose label columns are unchanged,
+# and freeze them so only the changed heads are trained. Returns the restored heads.
+def restore_heads(model):
+    if prev_weights is None or prev_weights['input'] != front_end() or round_cnt % FULL_RETRAIN_INTERVAL == 0:
+        return []
+    restored = []
+    for name, lo, hi in head_ranges():
+        if hi > lo and name in prev_weights['heads'] and prev_weights['heads'][name][0] == tuple(col_edge[lo:hi]):
+            model.get_layer(name).set_weights(prev_weights['heads'][name][1])
+            model.get_layer(name).trainable = False
+            restored.append(name)
+    if restored:
+        for name in TRUNK_LAYERS:
+            model.get_layer(name).set_weights(prev_weights['trunk'][name])
+            model.get_layer(name).trainable = False
+        compile_model(model, True)
+    return restored
+
+
+def save_heads(model, rows):
+    global prev_weights
+    prev_weights = {'input': front_end(), 'trunk': {}, 'heads': {}, 'rows': rows}
+    for name in TRUNK_LAYERS:
+        prev_weights['trunk'][name] = model.get_layer(name).get_weights()
+    for name, lo, hi in head_ranges():
+        if hi > lo:
+            prev_weights['heads'][name] = (tuple(col_edge[lo:hi]), model.get_layer(name).get_weights())
+
+
+# Greedy weighted coverage: pick seeds that add the most not yet covered label mass,
+# where rare columns weigh more and newer seeds get a recency bonus. Gains only
+# shrink as coverage grows, so stale heap entries are refreshed lazily.
+def select_coreset(label, size):
+    n = label.shape[0]
+    weight = 1.0 / (np.sum(label, axis=0) + 1e-6)
+    recency = 1 + (CORESET_RECENCY - 1) * np.arange(n) / max(n - 1, 1)
+    cols = [np.nonzero(label[r])[0] for r in range(n)]
+    covered = np.zeros(label.shape[1])
+
+    def gain(r):
+        c = cols[r]
+        return recency[r] * np.sum(weight[c] * np.maximum(label[r, c] - covered[c], 0))
+
+    heap = [(-gain(r), r) for r in range(n)]
+    heapq.heapify(heap)
+    chosen = []
+    while heap and len(chosen) < size:
+        g, r = heapq.heappop(heap)
+        g = gain(r)
+        if g <= 0:
+            continue
+        if heap and g < -heap[0][0]:
+            heapq.heappush(heap, (-g, r))
+            continue
+        chosen.append(r)
+        covered[cols[r]] = np.maximum(covered[cols[r]], label[r, cols[r]])
+
+    # labels fully covered: fill the budget with the newest remaining seeds
+    taken = set(chosen)
+    for r in range(n - 1, -1, -1):
+        if len(chosen) >= size:
+            break
+        if r not in taken:
+            chosen.append(r)
+    chosen.sort()
+
+    full = np.max(label, axis=0)
+    kept = np.max(label[chosen], axis=0)
+    print("### coreset " + str(len(chosen)) + "/" + str(n) + " seeds keeps " + str(int(np.sum(kept > 0))) + "/" + str(int(np.sum(full > 0)))
+          + " label columns, " + str(round(float(np.sum(kept) / max(np.sum(full), 1e-6)), 4)) + " of label mass")
+    return chosen
+
+
 def train(model, seed, label):
+    if seed.shape[0] > CORESET_SIZE:
+        rows = select_coreset(label, CORESET_SIZE)
+        seed = seed[rows]
+        label = label[rows]
+    if MAX_BITMAP_SIZE > SAMPLED_LABELS:
+        train_sampled(model, seed, label)
+        return
+
+    # random held-out split for the plateau check
+    val = None
+    n_val = int(seed.shape[0] * VAL_SPLIT)
+    if n_val > 0:
+        perm = np.random.permutation(seed.shape[0])
+        val = (seed[perm[:n_val]], label[perm[:n_val]])
+        seed, label = seed[perm[n_val:]], label[perm[n_val:]]
 
     loss_history = LossHistory()
     lrate = keras.callbacks.LearningRateScheduler(step_decay)
-    save_best = keras.callbacks.ModelCheckpoint("model.h5", monitor='loss', verbose=0, save_best_only=True, save_weights_only=True, mode='min', period=1)
-
-    callbacks_list = [loss_history, lrate, save_best]
-
-    if seed.shape[0] > 5000:
-        model.fit(seed,label,
-                        batch_size=int(seed.shape[0]/50),
-                        epochs=300,
-                        verbose=1, callbacks=callbacks_list)
-    else:
-        model.fit(seed,label,
-                        steps_per_epoch=50,
-                        epochs=100,
-                        verbose=1, callbacks=callbacks_list)
+    callbacks_list = [loss_history, lrate, BestWeights(model), TrainBudget(train_budget(750))]
+
+    # the coreset keeps at most CORESET_SIZE seeds, so one fit schedule covers every round
+    model.fit(seed,label,
+                    steps_per_epoch=50,
+                    epochs=100,
+                    validation_data=val,
+                    validation_steps=1 if val else None,
+                    verbose=1, callbacks=callbacks_list)
+
+# label columns unchanged: start from the restored weights and fine-tune the whole
+# model briefly on the seeds added since the last round, replaying as many old ones
+def fine_tune(model, seed, label):
+    old = min(prev_weights['rows'], seed.shape[0])
+    new_rows = np.arange(old, seed.shape[0])
+    if len(new_rows) == 0:
+        print("### label columns unchanged and no new seeds, reuse previous model")
+        return
+    print("### label columns unchanged, fine-tune on " + str(len(new_rows)) + " new seeds")
+    replay = np.random.choice(old, min(old, len(new_rows)), replace=False)
+    rows = np.concatenate((new_rows, replay))
+    for layer in model.layers:
+        layer.trainable = True
+    compile_model(model, True)
+    if MAX_BITMAP_SIZE > SAMPLED_LABELS:
+        train_sampled(model, seed[rows], label[rows], FINE_TUNE_EPOCHS)
+        return
+    model.fit(seed[rows], label[rows],
+                    batch_size=max(32, int(len(rows)/50)),
+                    epochs=FINE_TUNE_EPOCHS,
+                    verbose=1, callbacks=[BestWeights(model), TrainBudget(train_budget(750))])
 
 def gen_grad(data):
     global round_cnt
     t0 = time.time()
+    # last round's efficacy sets the train budget and the edges to skip
+    load_efficacy()
     seed, label = process_data()
     model = build_model(label,True)
     weighted = True
-    train(model, seed, label)
+    restored = restore_heads(model)
+    heads = [name for name, lo, hi in head_ranges() if hi > lo]
+    if len(restored) == len(heads):
+        fine_tune(model, seed, label)
+    else:
+        if restored:
+            print("### fine-tune heads " + str([name for name in heads if name not in restored]))
+        train(model, seed, label)
+    publish_weights(model)
+    save_heads(model, seed.shape[0])
     gen_mutate3(model,750, True, seed, label, weighted)
     round_cnt = round_cnt + 1
     print(time.time() - t0)
@@ -503,14 +1310,13 @@ def setup_server():
     sock.bind((HOST, PORT))
     sock.listen(5)
 
+    # bootstrap: let mtfuzz start with heuristic gradients while the first model trains
     conn, addr = sock.accept()
     print('@@@@@@@@@@@@@connected by mtfuzz execution moduel' + str(addr))
-    gen_grad('train')
-    print("@@@@@@@@@@@@@@gen_data done")
-    conn.sendall(b"start")
-    data = conn.recv(1024)
+    gen_bootstrap_grad(750)
+    conn.sendall(b"boots")
     print("@@@@@@@@@@@start gen_data")
-    gen_grad(data)
+    gen_grad('train')
     print("@@@@@@@@@@@@gen_data done")
     conn.sendall(b"close?")
     conn.recv(1024)
@@ -532,5 +1338,6 @@ def setup_server():
             conn.close()
             print("@@@@@@@@@@@@@@@close connection")
 
-setup_server()
+if __name__ == '__main__':
+    setup_server()
 